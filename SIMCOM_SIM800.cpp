@@ -21,9 +21,26 @@
 #include "rtos/ThisThread.h"
 #include "drivers/BufferedSerial.h"
 #include "SIMCOM_SIM800_CellularInformation.h"
+#include "SIMCOM_SIM800_CellularContext.h"
+#include "SIMCOM_SIM800_ATBatch.h"
+#include "SIMCOM_SIM800_Stats.h"
+#include "SIMCOM_SIM800_Timing.h"
 
 #define PWR_KEY_TIMING 1500ms
 #define RST_KEY_TIMING 200ms
+#define BOOT_TIMEOUT       10000ms // Upper bound for the modem to answer after power on
+#define BOOT_PROBE_TIMEOUT 300ms
+#define BOOT_BACKOFF_MIN   100ms
+#define BOOT_BACKOFF_MAX   1000ms
+#define BOOT_READY_FLAG    1<<0
+
+#define BAUD_SWITCH_DELAY  50ms    // Modem changes rate after answering AT+IPR
+#define BAUD_VERIFY_PROBES 3
+
+// Rates accepted by AT+IPR, fastest first
+static const int baud_rates[] = {460800, 230400, 115200, 57600, 38400, 19200, 9600};
+
+static const char *const boot_urcs[] = {"RDY", "+CFUN: 1", "+CPIN: READY", "Call Ready", "SMS Ready"};
 
 using namespace std::chrono;
 using namespace mbed;
@@ -55,46 +72,191 @@ static const intptr_t cellular_properties[AT_CellularDevice::PROPERTY_MAX] = {
 };
 
 
-SIMCOM_SIM800::SIMCOM_SIM800(FileHandle *fh, PinName pwrkey, PinName reset, PinName supply): 
+SIMCOM_SIM800::SIMCOM_SIM800(FileHandle *fh, PinName pwrkey, PinName reset, PinName supply, PinName dtr): 
     AT_CellularDevice(fh),
     _powerkey(pwrkey, 0),
     _reset(reset, 1),
-    _supply(supply, 0)
+    _supply(supply, 0),
+    _serial(fh),
+    _sleep(fh, dtr),
+    _sleep_enabled(dtr != NC && MBED_CONF_SIMCOM_SIM800_SLEEP_IDLE_TIME > 0),
+    _send_delay(_at, cellular_properties[PROPERTY_AT_SEND_DELAY]),
+    _baud(MBED_CONF_SIMCOM_SIM800_BAUDRATE)
 {
     set_cellular_properties(cellular_properties);
+    if (_sleep_enabled) {
+        // Writes go through _sleep, which wakes the modem first
+        _at.set_file_handle(&_sleep);
+    }
+#if MBED_CONF_SIMCOM_SIM800_SEND_DELAY_CALIBRATION
+    SIMCOM_SIM800_Timing::attach(mbed::Callback<void(bool)>(&_send_delay, &SIMCOM_SIM800_SendDelay::record));
+#endif
     rtos::ThisThread::sleep_for(1000ms);
 }
 
 
+SIMCOM_SIM800::~SIMCOM_SIM800()
+{
+#if MBED_CONF_SIMCOM_SIM800_SEND_DELAY_CALIBRATION
+    SIMCOM_SIM800_Timing::attach(nullptr);
+#endif
+}
+
 nsapi_error_t SIMCOM_SIM800::init(){
     setup_at_handler();
-    _at.lock();
+    SIM800_AT_LOCK(_at);
+#ifdef MBED_CONF_SIMCOM_SIM800_BAUDRATE_TARGET
+    {
+        SIM800_STATS_SCOPE(baud_stats, SIM800_CMD_BAUD);
+        nsapi_error_t baud_err = negotiate_baud(MBED_CONF_SIMCOM_SIM800_BAUDRATE_TARGET);
+        SIM800_STATS_RESULT(baud_stats, baud_err != NSAPI_ERROR_OK);
+        if (baud_err != NSAPI_ERROR_OK) {
+            tr_warning("Baud rate negotiation failed, staying at %d", _baud);
+        }
+    }
+#endif
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_INIT);
+    SIMCOM_SIM800_ATBatch batch(_at);
+    nsapi_error_t err = NSAPI_ERROR_OK;
     for (int retry = 1; retry <= 3; retry++) {
+        if (retry > 1) {
+            SIM800_STATS_RETRY(stats);
+        }
         _at.clear_error();
         _at.flush();
-        _at.at_cmd_discard("E0", ""); // echo off
-        if (_at.get_last_error() == NSAPI_ERROR_OK) {
-            /*
-            0 Disable +CME ERROR: <err> result code and use ERROR instead.
-            1 Enable +CME ERROR: <err> result code and use numeric <err>
-            2 Enable+CME  ERROR:  <err>  result  code  and  use  verbose  <err>
-            */
-            _at.at_cmd_discard("+CMEE", "=1"); // verbose responses
-            _at.at_cmd_discard("+CFUN", "=1"); // set full functionality
-            if (_at.get_last_error() == NSAPI_ERROR_OK) {
-                break;
-            }
-        }
-        tr_debug("Wait 100ms to init modem");
-        rtos::ThisThread::sleep_for(100ms); // let modem have time to get ready
-    }
-    
+        batch.add("E0", ""); // echo off
+        /*
+        0 Disable +CME ERROR: <err> result code and use ERROR instead.
+        1 Enable +CME ERROR: <err> result code and use numeric <err>
+        2 Enable+CME  ERROR:  <err>  result  code  and  use  verbose  <err>
+        */
+        batch.add("+CMEE", "=", "%d", 1); // verbose responses
+        batch.add("+CFUN", "=", "%d", 1); // set full functionality
 #if defined (MBED_CONF_SIMCOM_SIM800_RTS) && defined(MBED_CONF_SIMCOM_SIM800_CTS)
-    _at.at_cmd_discard("+IFC", "=", "%d%d", 2, 2);
+        batch.add("+IFC", "=", "%d%d", 2, 2);
 #else
-    _at.at_cmd_discard("+IFC", "=", "%d%d", 0, 0);
+        batch.add("+IFC", "=", "%d%d", 0, 0);
 #endif
-    return _at.unlock_return_error();
+        if (_sleep_enabled) {
+            batch.add("+CSCLK", "=", "%d", 1); // sleep while DTR is high
+        }
+        err = batch.get_last_error();
+        if (err != NSAPI_ERROR_OK) {
+            // Sending the rest would leave the modem half configured
+            batch.clear();
+            break;
+        }
+        err = batch.execute();
+        if (err == NSAPI_ERROR_OK) {
+            break;
+        }
+        tr_debug("Wait to init modem");
+        rtos::ThisThread::sleep_for(SIMCOM_SIM800_Timing::backoff(retry + 1, 100ms, 800ms)); // let modem have time to get ready
+    }
+    SIM800_STATS_RESULT(stats, err != NSAPI_ERROR_OK);
+#if MBED_CONF_SIMCOM_SIM800_SEND_DELAY_CALIBRATION
+    // setup_at_handler() restored the 200 ms property, find what this link needs
+    if (err == NSAPI_ERROR_OK) {
+        _send_delay.calibrate();
+        _at.clear_error();
+    }
+#endif
+    if (_sleep_enabled && err == NSAPI_ERROR_OK) {
+        _sleep.start(get_queue(), milliseconds(MBED_CONF_SIMCOM_SIM800_SLEEP_IDLE_TIME), &_at);
+    }
+    _at.unlock();
+    return err;
+}
+
+int SIMCOM_SIM800::get_baud_rate() const
+{
+    return _baud;
+}
+
+void SIMCOM_SIM800::get_send_delay_stats(SIMCOM_SIM800_SendDelay::send_delay_stats_t *stats) const
+{
+    _send_delay.get_stats(stats);
+}
+
+void SIMCOM_SIM800::get_sleep_stats(SIMCOM_SIM800_Sleep::sleep_stats_t *stats) const
+{
+    _sleep.get_stats(stats);
+}
+
+void SIMCOM_SIM800::set_host_baud(int baud)
+{
+    // ATHandler::set_baud() would cast _sleep, set the rate on the serial port itself
+    static_cast<BufferedSerial *>(_serial)->set_baud(baud);
+    _baud = baud;
+    SIMCOM_SIM800_Timing::set_baud_rate(baud);
+    _at.flush();
+}
+
+nsapi_error_t SIMCOM_SIM800::verify_link()
+{
+    for (int i = 0; i < BAUD_VERIFY_PROBES; i++) {
+        if (probe_ready() != NSAPI_ERROR_OK) {
+            return NSAPI_ERROR_DEVICE_ERROR;
+        }
+    }
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t SIMCOM_SIM800::negotiate_baud(int target)
+{
+    const int base = _baud;
+
+#if MBED_CONF_SIMCOM_SIM800_BAUDRATE_STORED
+    // Warm boot, modem kept the rate stored with AT&W
+    if (target != base) {
+        set_host_baud(target);
+        if (verify_link() == NSAPI_ERROR_OK) {
+            tr_info("SIMCOM_SIM800 stored baud rate %d", target);
+            return NSAPI_ERROR_OK;
+        }
+        set_host_baud(base);
+    }
+#endif
+
+    // First AT lets an autobauding modem lock on to the base rate
+    if (probe_ready() != NSAPI_ERROR_OK && verify_link() != NSAPI_ERROR_OK) {
+        return NSAPI_ERROR_DEVICE_ERROR;
+    }
+
+    for (int rate : baud_rates) {
+        if (rate > target) {
+            continue;
+        }
+        if (rate <= base) {
+            break;
+        }
+        _at.clear_error();
+        if (_at.at_cmd_discard("+IPR", "=", "%d", rate) != NSAPI_ERROR_OK) {
+            continue;
+        }
+        ThisThread::sleep_for(BAUD_SWITCH_DELAY);
+        set_host_baud(rate);
+        if (verify_link() == NSAPI_ERROR_OK) {
+            tr_info("SIMCOM_SIM800 baud rate %d", rate);
+#if MBED_CONF_SIMCOM_SIM800_BAUDRATE_STORED
+            _at.at_cmd_discard("&W", "");
+#endif
+            _at.clear_error();
+            return NSAPI_ERROR_OK;
+        }
+
+        // Link unreliable at this rate, ask the modem to return to the verified one
+        tr_debug("Baud rate %d failed verification", rate);
+        _at.clear_error();
+        _at.at_cmd_discard("+IPR", "=", "%d", base);
+        ThisThread::sleep_for(BAUD_SWITCH_DELAY);
+        set_host_baud(base);
+        if (verify_link() != NSAPI_ERROR_OK) {
+            return NSAPI_ERROR_DEVICE_ERROR;
+        }
+    }
+    _at.clear_error();
+    return NSAPI_ERROR_OK;
 }
 
 #if MBED_CONF_SIMCOM_SIM800_PROVIDE_DEFAULT
@@ -106,7 +268,12 @@ CellularDevice *CellularDevice::get_default_instance()
     tr_debug("SIMCOM_SIM800 flow control: RTS %d CTS %d", MBED_CONF_SIMCOM_SIM800_RTS, MBED_CONF_SIMCOM_SIM800_CTS);
     serial.set_flow_control(SerialBase::RTSCTS, MBED_CONF_SIMCOM_SIM800_RTS, MBED_CONF_SIMCOM_SIM800_CTS);
 #endif
+#ifdef MBED_CONF_SIMCOM_SIM800_DTR
+    static SIMCOM_SIM800 device(&serial, MBED_CONF_SIMCOM_SIM800_PWRKEY, MBED_CONF_SIMCOM_SIM800_RESET, MBED_CONF_SIMCOM_SIM800_SUPPLY,
+                                MBED_CONF_SIMCOM_SIM800_DTR);
+#else
     static SIMCOM_SIM800 device(&serial, MBED_CONF_SIMCOM_SIM800_PWRKEY, MBED_CONF_SIMCOM_SIM800_RESET, MBED_CONF_SIMCOM_SIM800_SUPPLY);
+#endif
     return &device;
 }
 #endif
@@ -116,21 +283,70 @@ nsapi_error_t SIMCOM_SIM800::soft_power_on()
     if (_powerkey.is_connected()) {
         tr_info("SIMCOM_SIM800::soft_power_on");
         // check if modem was powered on already
-        if(is_ready() != NSAPI_ERROR_OK)
-        {
-            _powerkey = 1;
-            ThisThread::sleep_for(PWR_KEY_TIMING);
-            _powerkey = 0;
+        if (probe_ready() == NSAPI_ERROR_OK) {
+            return NSAPI_ERROR_OK;
+        }
+        _powerkey = 1;
+        ThisThread::sleep_for(PWR_KEY_TIMING);
+        _powerkey = 0;
+    }
+    return wait_ready(BOOT_TIMEOUT);
+}
+
+nsapi_error_t SIMCOM_SIM800::wait_ready(milliseconds timeout)
+{
+    // Boot URCs cut the backoff short, AT probes cover autobaud where the modem stays silent
+    for (const char *urc : boot_urcs) {
+        _at.set_urc_handler(urc, mbed::Callback<void()>(this, &SIMCOM_SIM800::urc_ready));
+    }
+    _boot_flags.clear(BOOT_READY_FLAG);
+
+    nsapi_error_t err = NSAPI_ERROR_TIMEOUT;
+    milliseconds backoff = BOOT_BACKOFF_MIN;
+    auto deadline = Kernel::Clock::now() + timeout;
+    while (true) {
+        if (probe_ready() == NSAPI_ERROR_OK) {
+            err = NSAPI_ERROR_OK;
+            break;
+        }
+        auto now = Kernel::Clock::now();
+        if (now >= deadline) {
+            break;
         }
+        milliseconds wait = duration_cast<milliseconds>(deadline - now);
+        _boot_flags.wait_any_for(BOOT_READY_FLAG, wait < backoff ? wait : backoff);
+        backoff = backoff * 2 < BOOT_BACKOFF_MAX ? backoff * 2 : BOOT_BACKOFF_MAX;
     }
-    ThisThread::sleep_for(10000ms);
-    //tr_info("SIMCOM_SIM800::soft_power_on - waiting 6sec");
-    return NSAPI_ERROR_OK;
+
+    for (const char *urc : boot_urcs) {
+        _at.set_urc_handler(urc, nullptr);
+    }
+    tr_info("SIMCOM_SIM800 %s", err == NSAPI_ERROR_OK ? "ready" : "not responding");
+    return err;
+}
+
+nsapi_error_t SIMCOM_SIM800::probe_ready()
+{
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_BOOT);
+    SIM800_AT_LOCK(_at);
+    _at.flush();
+    _at.clear_error();
+    _at.set_at_timeout(BOOT_PROBE_TIMEOUT);
+    _at.at_cmd_discard("", "");
+    _at.restore_at_timeout();
+    SIM800_STATS_RESULT(stats, _at.get_last_error() != NSAPI_ERROR_OK);
+    return _at.unlock_return_error();
+}
+
+void SIMCOM_SIM800::urc_ready()
+{
+    _boot_flags.set(BOOT_READY_FLAG);
 }
 
 nsapi_error_t SIMCOM_SIM800::soft_power_off()
 {
     tr_info("SIM800::soft_power_off");
+    _sleep.stop();
     if (_powerkey.is_connected()) {
         _powerkey = 1;
         ThisThread::sleep_for(PWR_KEY_TIMING);
@@ -186,3 +402,13 @@ nsapi_error_t SIMCOM_SIM800::hard_power_off(){
 AT_CellularInformation *SIMCOM_SIM800::open_information_impl(ATHandler &at){
     return new SIMCOM_SIM800_CellularInformation(at, *this);
 }
+
+AT_CellularContext *SIMCOM_SIM800::create_context_impl(ATHandler &at, const char *apn, bool cp_req, bool nonip_req){
+#if MBED_CONF_SIMCOM_SIM800_SOCKET_STACK && !NSAPI_PPP_AVAILABLE
+    // The TCP/IP application only carries IP over the packet domain
+    if (!cp_req && !nonip_req) {
+        return new SIMCOM_SIM800_CellularContext(at, this, apn, cp_req, nonip_req);
+    }
+#endif
+    return AT_CellularDevice::create_context_impl(at, apn, cp_req, nonip_req);
+}
@@ -21,6 +21,10 @@
 
 #include "AT_CellularDevice.h"
 #include "DigitalOut.h"
+#include "SIMCOM_SIM800_Sleep.h"
+#include "SIMCOM_SIM800_SendDelay.h"
+#include "rtos/EventFlags.h"
+#include <chrono>
 
 
 namespace mbed {
@@ -40,7 +44,19 @@ namespace mbed {
  */
 class SIMCOM_SIM800 : public AT_CellularDevice {
 public:
-    SIMCOM_SIM800(FileHandle *fh, PinName pwrkey = NC, PinName reset = NC, PinName supply = NC);
+    SIMCOM_SIM800(FileHandle *fh, PinName pwrkey = NC, PinName reset = NC, PinName supply = NC, PinName dtr = NC);
+    virtual ~SIMCOM_SIM800();
+
+    /** Current host side baud rate, updated by baud rate negotiation in init().
+     *  FileHandle passed to the constructor must be a BufferedSerial for negotiation.
+     */
+    int get_baud_rate() const;
+
+    /** Slow clock sleep counters. Sleep needs the DTR pin and a non-zero sleep-idle-time config. */
+    void get_sleep_stats(SIMCOM_SIM800_Sleep::sleep_stats_t *stats) const;
+
+    /** Inter-command delay chosen by calibration in init() and runtime error counts */
+    void get_send_delay_stats(SIMCOM_SIM800_SendDelay::send_delay_stats_t *stats) const;
     
 protected: // AT_CellularDevice
     virtual nsapi_error_t soft_power_on();  // Turn on  modem with pwrkey
@@ -49,12 +65,27 @@ protected: // AT_CellularDevice
     virtual nsapi_error_t hard_power_off();
     virtual nsapi_error_t init();
     virtual AT_CellularInformation *open_information_impl(ATHandler &at);
+    virtual AT_CellularContext *create_context_impl(ATHandler &at, const char *apn, bool cp_req = false, bool nonip_req = false);
 
 
 private:
+    nsapi_error_t wait_ready(std::chrono::milliseconds timeout);
+    nsapi_error_t probe_ready();
+    void urc_ready();
+    nsapi_error_t negotiate_baud(int target);
+    nsapi_error_t verify_link();
+    void set_host_baud(int baud);
+
     DigitalOut _powerkey; //Modem power on/off
     DigitalOut _reset;    //Modem reset pin
     DigitalOut _supply;   //DC-DC power supply enable pin
+    FileHandle *_serial;  //Serial port, the ATHandler may use it through _sleep
+    SIMCOM_SIM800_Sleep _sleep; //DTR controlled slow clock
+    bool _sleep_enabled;
+    SIMCOM_SIM800_SendDelay _send_delay; //Calibrated PROPERTY_AT_SEND_DELAY
+
+    rtos::EventFlags _boot_flags; //Set by boot URCs (RDY, Call Ready...)
+    int _baud;                    //Host UART baud rate
 };
 } // namespace mbed
 #endif // SIMCOM_SIM800C_H_
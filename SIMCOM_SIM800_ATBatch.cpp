@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_ATBatch.h"
+#include "CellularLog.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace mbed;
+
+SIMCOM_SIM800_ATBatch::SIMCOM_SIM800_ATBatch(ATHandler &at): _at(at), _len(0), _count(0), _error(NSAPI_ERROR_OK)
+{
+
+}
+
+void SIMCOM_SIM800_ATBatch::clear()
+{
+    _len = 0;
+    _count = 0;
+    _error = NSAPI_ERROR_OK;
+}
+
+int SIMCOM_SIM800_ATBatch::count() const
+{
+    return _count;
+}
+
+nsapi_error_t SIMCOM_SIM800_ATBatch::get_last_error() const
+{
+    return _error;
+}
+
+nsapi_error_t SIMCOM_SIM800_ATBatch::add(const char *cmd, const char *cmd_chr, const char *format, ...)
+{
+    va_list list;
+    va_start(list, format);
+    nsapi_error_t err = vadd(cmd, cmd_chr, format, list);
+    va_end(list);
+    if (err != NSAPI_ERROR_OK && _error == NSAPI_ERROR_OK) {
+        _error = err;
+    }
+    return err;
+}
+
+nsapi_error_t SIMCOM_SIM800_ATBatch::vadd(const char *cmd, const char *cmd_chr, const char *format, va_list list)
+{
+    if (_count >= AT_BATCH_MAX_COMMANDS) {
+        return NSAPI_ERROR_NO_MEMORY;
+    }
+
+    size_t len = _len;
+    int n = snprintf(_buf + len, sizeof(_buf) - len, "%s%s", cmd, cmd_chr);
+    if (n < 0 || (size_t)n >= sizeof(_buf) - len) {
+        return NSAPI_ERROR_NO_MEMORY;
+    }
+    len += n;
+
+    bool first = true;
+    for (const char *f = format; *f; f++) {
+        if (*f != '%') {
+            continue;
+        }
+        f++;
+        const char *sep = first ? "" : ",";
+        first = false;
+        if (*f == 'd') {
+            n = snprintf(_buf + len, sizeof(_buf) - len, "%s%d", sep, va_arg(list, int));
+        } else if (*f == 'u') {
+            n = snprintf(_buf + len, sizeof(_buf) - len, "%s%u", sep, va_arg(list, unsigned int));
+        } else if (*f == 's') {
+            const char *str = va_arg(list, const char *);
+            n = snprintf(_buf + len, sizeof(_buf) - len, "%s\"%s\"", sep, str ? str : "");
+        } else {
+            return NSAPI_ERROR_PARAMETER;
+        }
+        if (n < 0 || (size_t)n >= sizeof(_buf) - len) {
+            return NSAPI_ERROR_NO_MEMORY;
+        }
+        len += n;
+    }
+
+    // Every command must fit in a line of its own after "AT"
+    if (2 + len - _len >= AT_BATCH_LINE_LENGTH) {
+        return NSAPI_ERROR_NO_MEMORY;
+    }
+    // Commands are stored back to back, each NUL terminated
+    if (len + 1 > sizeof(_buf)) {
+        return NSAPI_ERROR_NO_MEMORY;
+    }
+    _buf[len++] = '\0';
+    _start[_count++] = _len;
+    _len = len;
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t SIMCOM_SIM800_ATBatch::execute()
+{
+    nsapi_error_t err = NSAPI_ERROR_OK;
+    int first = 0;
+
+    _at.lock();
+    while (first < _count) {
+        // Greedily fill one command line, extended commands are separated by ';'
+        size_t line_len = 2;
+        int last = first;
+        while (last < _count) {
+            const char *cmd = _buf + _start[last];
+            size_t need = strlen(cmd) + (last > first && _buf[_start[last - 1]] == '+' ? 1 : 0);
+            if (last > first && line_len + need >= AT_BATCH_LINE_LENGTH) {
+                break;
+            }
+            line_len += need;
+            last++;
+        }
+
+        nsapi_error_t line_err = send_range(first, last);
+        if (line_err != NSAPI_ERROR_OK && last - first > 1) {
+            tr_debug("AT batch failed, sending %d commands one by one", last - first);
+            line_err = NSAPI_ERROR_OK;
+            for (int i = first; i < last; i++) {
+                nsapi_error_t cmd_err = send_range(i, i + 1);
+                if (line_err == NSAPI_ERROR_OK) {
+                    line_err = cmd_err;
+                }
+            }
+        }
+        if (err == NSAPI_ERROR_OK) {
+            err = line_err;
+        }
+        first = last;
+    }
+    _at.unlock();
+    clear();
+    return err;
+}
+
+nsapi_error_t SIMCOM_SIM800_ATBatch::send_range(int first, int last)
+{
+    char line[AT_BATCH_LINE_LENGTH + 1];
+    size_t len = 0;
+
+    line[len++] = 'A';
+    line[len++] = 'T';
+    for (int i = first; i < last; i++) {
+        const char *cmd = _buf + _start[i];
+        size_t cmd_len = strlen(cmd);
+        if (i > first && _buf[_start[i - 1]] == '+') {
+            line[len++] = ';';
+        }
+        // execute() sized the range and add() bounds single commands
+        memcpy(line + len, cmd, cmd_len);
+        len += cmd_len;
+    }
+    line[len] = '\0';
+    return send(line);
+}
+
+nsapi_error_t SIMCOM_SIM800_ATBatch::send(const char *line)
+{
+    _at.clear_error();
+    _at.flush();
+    _at.cmd_start(line);
+    _at.cmd_stop();
+    _at.resp_start();
+    _at.resp_stop();
+    return _at.get_last_error();
+}
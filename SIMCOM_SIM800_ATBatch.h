@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_ATBATCH_H_
+#define SIMCOM_SIM800_ATBATCH_H_
+
+#include "ATHandler.h"
+#include <stdarg.h>
+#include <stdint.h>
+
+#define AT_BATCH_MAX_COMMANDS 12
+#define AT_BATCH_LINE_LENGTH  256   // SIM800 accepts up to 556 characters per command line
+#define AT_BATCH_BUFFER_SIZE  512   // Queued commands, execute() splits them into lines
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_ATBatch
+ *
+ * Packs several commands into one "AT<cmd1>;<cmd2>..." line so a setup
+ * sequence pays for a single round-trip and inter-command delay.
+ * Only for commands whose response is the final result code: information
+ * responses are discarded. If the combined line fails, every command is
+ * re-sent on its own.
+ */
+class SIMCOM_SIM800_ATBatch {
+public:
+    SIMCOM_SIM800_ATBatch(ATHandler &at);
+
+    /** Append a command using the ATHandler::at_cmd_discard convention,
+     *  e.g. add("+SAPBR", "=", "%d%d%s%s", 3, 1, "APN", apn).
+     *  Format supports %d (int), %u (unsigned int) and %s (quoted string, nullptr sends "").
+     *  A failed add() is also kept for get_last_error().
+     *
+     *  @return NSAPI_ERROR_NO_MEMORY if the batch is full or the command does not fit
+     *          in one line, NSAPI_ERROR_PARAMETER on a bad format
+     */
+    nsapi_error_t add(const char *cmd, const char *cmd_chr, const char *format = "", ...);
+
+    /** Send the batch and clear it.
+     *
+     *  @return NSAPI_ERROR_OK, or the first error of the one-by-one fallback
+     */
+    nsapi_error_t execute();
+
+    void clear();
+    int count() const;
+
+    /** First add() error since the last execute() or clear(). Callers that
+     *  must not send a partial setup check it before execute().
+     */
+    nsapi_error_t get_last_error() const;
+
+private:
+    nsapi_error_t vadd(const char *cmd, const char *cmd_chr, const char *format, va_list list);
+    nsapi_error_t send(const char *line);
+    nsapi_error_t send_range(int first, int last);
+
+    ATHandler &_at;
+    char      _buf[AT_BATCH_BUFFER_SIZE];
+    size_t    _len;
+    uint16_t  _start[AT_BATCH_MAX_COMMANDS];
+    int       _count;
+    nsapi_error_t _error;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_ATBATCH_H_
@@ -1,17 +1,75 @@
 #include "SIMCOM_SIM800_Bearer.h"
+#include "SIMCOM_SIM800_ATBatch.h"
+#include "SIMCOM_SIM800_Stats.h"
+#include "SIMCOM_SIM800_Timing.h"
+#include "platform/ScopedLock.h"
+#include <stdio.h>
+#include <string.h>
 
 using namespace mbed;
 using namespace std::chrono_literals;
 
-SIMCOM_SIM800_Bearer::SIMCOM_SIM800_Bearer(AT_CellularDevice &device): _device(device), _at(*device.get_at_handler())
+SIMCOM_SIM800_Bearer *SIMCOM_SIM800_Bearer::_profiles[BEARER_CID_MAX + 1];
+rtos::Mutex SIMCOM_SIM800_Bearer::_http_mutex;
+
+SIMCOM_SIM800_Bearer::SIMCOM_SIM800_Bearer(AT_CellularDevice &device, int cid):
+    _cid(cid),
+    _at(*device.get_at_handler()),
+    _device(device),
+    _http(nullptr),
+    _queue(device.get_queue()),
+    _state(closed),
+    _keep_connected(false),
+    _reconnect_id(0),
+    _reconnect_delay(MBED_CONF_SIMCOM_SIM800_BEARER_RECONNECT_MIN_DELAY),
+    _status_valid(false),
+    _worker_queue(BEARER_WORKER_EVENTS * EVENTS_EVENT_SIZE),
+    _worker(osPriorityNormal, MBED_CONF_SIMCOM_SIM800_BEARER_THREAD_STACK_SIZE, nullptr, "sim800_bearer"),
+    _worker_started(false)
 {
+    strcpy(_ip, "0.0.0.0");
+    if (_cid < BEARER_CID_MIN || _cid > BEARER_CID_MAX) {
+        tr_warning("Bearer CID %d out of range, using %d", _cid, BEARER_CID_MIN);
+        _cid = BEARER_CID_MIN;
+    }
+    if (_profiles[_cid]) {
+        tr_warning("Bearer CID %d already in use", _cid);
+    } else {
+        _profiles[_cid] = this;
+    }
+    snprintf(_deact_urc, sizeof(_deact_urc), "+SAPBR %d: DEACT", _cid);
+    _at.set_urc_handler(_deact_urc, mbed::Callback<void()>(this, &SIMCOM_SIM800_Bearer::urc_deact));
+}
 
+SIMCOM_SIM800_Bearer::~SIMCOM_SIM800_Bearer()
+{
+    _at.set_urc_handler(_deact_urc, nullptr);
+    if (_reconnect_id) {
+        _worker_queue.cancel(_reconnect_id);
+    }
+    _http_mutex.lock();
+    if (_profiles[_cid] == this) {
+        _profiles[_cid] = nullptr;
+    }
+    if (_http_idle_id) {
+        _worker_queue.cancel(_http_idle_id);
+        http_idle();
+    }
+    _http_mutex.unlock();
+    if (_worker_started) {
+        _worker_queue.break_dispatch();
+        _worker.join();
+    }
 }
 
-//~SIMCOM_SIM800_Bearer()
-//{
-//
-//}
+events::EventQueue *SIMCOM_SIM800_Bearer::worker()
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    if (!_worker_started) {
+        _worker_started = (_worker.start(mbed::callback(&_worker_queue, &events::EventQueue::dispatch_forever)) == osOK);
+    }
+    return &_worker_queue;
+}
 
 void SIMCOM_SIM800_Bearer::set_credentials(const char *apn, const char *uname, const char *pwd)
 {
@@ -23,12 +81,22 @@ void SIMCOM_SIM800_Bearer::set_credentials(const char *apn, const char *uname, c
 nsapi_error_t SIMCOM_SIM800_Bearer::setup_bearer()
 {
     tr_info("enter setup_bearer");
-    _at.at_cmd_discard("+SAPBR","=", "%d%d%s%s", 3,1,"Contype","GPRS");
-    _at.at_cmd_discard("+SAPBR","=", "%d%d%s%s", 3,1,"APN",(_apn));
-    _at.at_cmd_discard("+SAPBR","=", "%d%d%s%s", 3,1,"USER",(_uname));
-    _at.at_cmd_discard("+SAPBR","=", "%d%d%s%s", 3,1,"PWD",(_pwd));
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_SAPBR);
+    SIMCOM_SIM800_ATBatch batch(_at);
+    batch.add("+SAPBR","=", "%d%d%s%s", 3,_cid,"Contype","GPRS");
+    batch.add("+SAPBR","=", "%d%d%s%s", 3,_cid,"APN",(_apn));
+    batch.add("+SAPBR","=", "%d%d%s%s", 3,_cid,"USER",(_uname));
+    batch.add("+SAPBR","=", "%d%d%s%s", 3,_cid,"PWD",(_pwd));
+    nsapi_error_t err = batch.get_last_error();
+    if (err == NSAPI_ERROR_OK) {
+        err = batch.execute();
+    } else {
+        // Never open the bearer with a truncated APN or credential
+        tr_warning("Bearer %d settings too long", _cid);
+    }
+    SIM800_STATS_RESULT(stats, err != NSAPI_ERROR_OK);
     tr_info("exit setup_bearer");
-    return NSAPI_ERROR_OK;
+    return err;
 }
 
 void SIMCOM_SIM800_Bearer::init_bearer(const char* apn, const char *uname, const char *pwd)
@@ -58,65 +126,271 @@ tr_info("enter init_bearer");
 
 gprs_status_t SIMCOM_SIM800_Bearer::get_bearer_status(char* ipaddress, size_t length)
 {
-    //+SAPBR: 1,1,"10.138.2.236"
-    gprs_status_t status;
+    if (_status_valid &&
+            rtos::Kernel::Clock::now() - _status_time < std::chrono::milliseconds(MBED_CONF_SIMCOM_SIM800_BEARER_STATUS_TTL)) {
+        return cached_bearer_status(ipaddress, length);
+    }
+    return refresh_bearer_status(ipaddress, length);
+}
+
+gprs_status_t SIMCOM_SIM800_Bearer::refresh_bearer_status(char* ipaddress, size_t length)
+{
+    //+SAPBR: <cid>,1,"10.138.2.236"
+    gprs_status_t status = closed;
+    char ip[IPV4_ADDRESS_LENGTH + 1] = {0};
 
-    _at.lock();
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_SAPBR);
+    SIM800_AT_LOCK(_at);
     _at.flush();
     _at.clear_error();
-    _at.set_at_timeout(5000ms);
-    _at.cmd_start_stop("+SAPBR", "=", "%d%d", 2,1);
+    auto start = SIMCOM_SIM800_Timing::start();
+    _at.set_at_timeout(SIMCOM_SIM800_Timing::timeout(SIM800_CMD_SAPBR, SIM800_TIMING_MIN_TIMEOUT, BEARER_QUERY_TIMEOUT));
+    _at.cmd_start_stop("+SAPBR", "=", "%d%d", 2,_cid);
     _at.resp_start("+SAPBR:");
     if(_at.info_resp())
     {
         _at.skip_param(1);
         status = _at.read_int();
-        tr_info("\nGPRS status - %d\n", status);
-        if(ipaddress == nullptr)
-        {
-            _at.skip_param(1);
-        }
-        else
-        {
-            _at.read_string(ipaddress, length);
-            ipaddress[IPV4_ADDRESS_LENGTH+1] = '\0';
-            tr_info("\nIP address - %s\n", ipaddress);
-        }
+        _at.read_string(ip, sizeof(ip));
     }
     _at.resp_stop();
+    SIMCOM_SIM800_Timing::complete(SIM800_CMD_SAPBR, _at, start);
     _at.restore_at_timeout();
-    _at.unlock();
+    nsapi_error_t err = _at.unlock_return_error();
+    SIM800_STATS_RX(stats, strlen(ip));
+    SIM800_STATS_RESULT(stats, err != NSAPI_ERROR_OK);
 
+    if(err != NSAPI_ERROR_OK || status < connecting || status > closed)
+    {
+        // Modem state unknown, next call queries again
+        _status_valid = false;
+        copy_ip(ipaddress, length, "0.0.0.0");
+        return closed;
+    }
+    tr_info("GPRS status - %d, IP address - %s", status, ip);
+    _status_time = rtos::Kernel::Clock::now();
+    _status_valid = true;
+    set_state(status);
+    set_ip(ip);
+    copy_ip(ipaddress, length, _ip);
     return status;
 }
 
+gprs_status_t SIMCOM_SIM800_Bearer::cached_bearer_status(char* ipaddress, size_t length) const
+{
+    copy_ip(ipaddress, length, _ip);
+    return _state;
+}
+
+void SIMCOM_SIM800_Bearer::copy_ip(char *dst, size_t length, const char *src)
+{
+    if(dst == nullptr || length == 0)
+    {
+        return;
+    }
+    strncpy(dst, src, length - 1);
+    dst[length - 1] = '\0';
+}
+
 nsapi_error_t SIMCOM_SIM800_Bearer::enable_bearer(bool onoff)
 {
+    nsapi_error_t err;
     tr_info("enter enable_bearer");
     if(onoff)
     {
-    _at.lock();
+    set_state(connecting);
+    {
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_SAPBR_OPEN);
+    SIM800_AT_LOCK(_at);
     _at.flush();
     _at.clear_error();
-    _at.set_at_timeout(85000ms);
-    _at.cmd_start_stop("+SAPBR", "=", "%d%d", 1,1);
+    auto start = SIMCOM_SIM800_Timing::start();
+    _at.set_at_timeout(SIMCOM_SIM800_Timing::timeout(SIM800_CMD_SAPBR_OPEN, BEARER_OPEN_MIN_TIMEOUT, BEARER_OPEN_TIMEOUT));
+    _at.cmd_start_stop("+SAPBR", "=", "%d%d", 1,_cid);
     _at.resp_start();
     _at.resp_stop();
+    SIMCOM_SIM800_Timing::complete(SIM800_CMD_SAPBR_OPEN, _at, start);
     _at.restore_at_timeout();
+    SIM800_STATS_RESULT(stats, _at.get_last_error() != NSAPI_ERROR_OK);
     _at.unlock();
     }
+    // ERROR is also returned when the bearer is already open. The query
+    // settles the state and caches the new address.
+    err = (refresh_bearer_status() == connected) ? NSAPI_ERROR_OK : NSAPI_ERROR_NO_CONNECTION;
+    if(err != NSAPI_ERROR_OK)
+    {
+        set_state(closed);
+    }
+    }
     else
     {
-        _at.at_cmd_discard("+SAPBR","=", "%d%d", 0,1);
+        set_state(closing);
+        SIM800_STATS_SCOPE(stats, SIM800_CMD_SAPBR);
+        err = _at.at_cmd_discard("+SAPBR","=", "%d%d", 0,_cid);
+        SIM800_STATS_RESULT(stats, err != NSAPI_ERROR_OK);
+        if(err == NSAPI_ERROR_OK)
+        {
+            set_state(closed);
+            set_ip("0.0.0.0");
+        }
+        else
+        {
+            refresh_bearer_status();
+        }
     }
     tr_info("exit enable_bearer");
-    return NSAPI_ERROR_OK;
+    return err;
+}
+
+void SIMCOM_SIM800_Bearer::attach(bearer_status_cb_t cb)
+{
+    _status_cb = cb;
+}
+
+gprs_status_t SIMCOM_SIM800_Bearer::get_state() const
+{
+    return _state;
+}
+
+int SIMCOM_SIM800_Bearer::get_cid() const
+{
+    return _cid;
+}
+
+nsapi_error_t SIMCOM_SIM800_Bearer::connect_async()
+{
+    _keep_connected = true;
+    _reconnect_delay = std::chrono::milliseconds(MBED_CONF_SIMCOM_SIM800_BEARER_RECONNECT_MIN_DELAY);
+    return worker()->call(mbed::callback(this, &SIMCOM_SIM800_Bearer::do_connect)) ? NSAPI_ERROR_OK : NSAPI_ERROR_NO_MEMORY;
+}
+
+nsapi_error_t SIMCOM_SIM800_Bearer::disconnect_async()
+{
+    _keep_connected = false;
+    _mutex.lock();
+    if (_reconnect_id) {
+        _worker_queue.cancel(_reconnect_id);
+        _reconnect_id = 0;
+    }
+    _mutex.unlock();
+    return worker()->call(mbed::callback(this, &SIMCOM_SIM800_Bearer::do_disconnect)) ? NSAPI_ERROR_OK : NSAPI_ERROR_NO_MEMORY;
+}
+
+void SIMCOM_SIM800_Bearer::do_connect()
+{
+    _mutex.lock();
+    _reconnect_id = 0;
+    _mutex.unlock();
+    if (!_keep_connected || _state == connected) {
+        return;
+    }
+    if (enable_bearer(true) == NSAPI_ERROR_OK) {
+        _reconnect_delay = std::chrono::milliseconds(MBED_CONF_SIMCOM_SIM800_BEARER_RECONNECT_MIN_DELAY);
+    } else {
+        schedule_reconnect();
+    }
+}
+
+void SIMCOM_SIM800_Bearer::do_disconnect()
+{
+    if (_state != closed) {
+        enable_bearer(false);
+    }
+}
+
+void SIMCOM_SIM800_Bearer::schedule_reconnect()
+{
+    // Called from URC context too, the worker thread runs the reconnect
+    events::EventQueue *queue = worker();
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    if (!_keep_connected || _reconnect_id) {
+        return;
+    }
+    // Random delay in [delay/2, delay] keeps a fleet from reconnecting in lockstep
+    std::chrono::milliseconds delay = SIMCOM_SIM800_Timing::jitter(_reconnect_delay);
+    tr_info("Bearer %d reconnect in %d ms", _cid, (int)delay.count());
+    _reconnect_id = queue->call_in(delay, mbed::callback(this, &SIMCOM_SIM800_Bearer::do_connect));
+    _reconnect_delay *= 2;
+    if (_reconnect_delay.count() > MBED_CONF_SIMCOM_SIM800_BEARER_RECONNECT_MAX_DELAY) {
+        _reconnect_delay = std::chrono::milliseconds(MBED_CONF_SIMCOM_SIM800_BEARER_RECONNECT_MAX_DELAY);
+    }
+}
+
+void SIMCOM_SIM800_Bearer::urc_deact()
+{
+    // URC context, AT commands are issued later from the event queue
+    tr_info("Bearer %d deactivated by network", _cid);
+    set_state(closed);
+    set_ip("0.0.0.0");
+    _status_time = rtos::Kernel::Clock::now();
+    _status_valid = true;
+    schedule_reconnect();
+}
+
+void SIMCOM_SIM800_Bearer::attach_ip_change(bearer_ip_cb_t cb)
+{
+    _ip_cb = cb;
+}
+
+void SIMCOM_SIM800_Bearer::set_ip(const char *ipaddress)
+{
+    if (strcmp(_ip, ipaddress) == 0) {
+        return;
+    }
+    copy_ip(_ip, sizeof(_ip), ipaddress);
+    if (_ip_cb) {
+        // Listener reads the cache, the event may run after a later change
+        _queue->call(this, &SIMCOM_SIM800_Bearer::notify_ip);
+    }
+}
+
+void SIMCOM_SIM800_Bearer::notify_ip()
+{
+    char ip[IPV4_ADDRESS_LENGTH + 1];
+    copy_ip(ip, sizeof(ip), _ip);
+    if (_ip_cb) {
+        _ip_cb(ip);
+    }
+}
+
+void SIMCOM_SIM800_Bearer::set_state(gprs_status_t state)
+{
+    if (_state == state) {
+        return;
+    }
+    _state = state;
+    if (_status_cb) {
+        _queue->call(_status_cb, state);
+    }
 }
 
 SIMCOM_SIM800_HTTP *SIMCOM_SIM800_Bearer::open_http()
 {
+    // An idle release the cancel misses waits here and then finds the service in use
+    ScopedLock<rtos::Mutex> lock(_http_mutex);
+    if (_http_idle_id) {
+        _worker_queue.cancel(_http_idle_id);
+        _http_idle_id = 0;
+    }
     if (!_http) {
+        for (int cid = BEARER_CID_MIN; cid <= BEARER_CID_MAX; cid++) {
+            SIMCOM_SIM800_Bearer *other = _profiles[cid];
+            if (!other || other == this || !other->_http) {
+                continue;
+            }
+            if (other->_http_ref_count) {
+                tr_info("HTTP service in use by bearer %d", cid);
+                return nullptr;
+            }
+            // Kept idle session of another profile, release it now
+            if (other->_http_idle_id) {
+                other->_worker_queue.cancel(other->_http_idle_id);
+            }
+            other->http_idle();
+        }
         _http = open_http_impl(*_device.get_at_handler());
+        _http->set_session_keep(MBED_CONF_SIMCOM_SIM800_HTTP_SESSION_IDLE_TIMEOUT > 0);
+        _http->bind_cid(_cid);
     }
     _http_ref_count++;
     return _http;
@@ -124,12 +398,34 @@ SIMCOM_SIM800_HTTP *SIMCOM_SIM800_Bearer::open_http()
 
 void SIMCOM_SIM800_Bearer::close_http()
 {
+    ScopedLock<rtos::Mutex> lock(_http_mutex);
     if (_http) {
         _http_ref_count--;
         if (_http_ref_count == 0) {
-            delete _http;
-            _http = NULL;
+#if MBED_CONF_SIMCOM_SIM800_HTTP_SESSION_IDLE_TIMEOUT > 0
+            // +HTTPTERM and its retries stay off the device event queue
+            _http_idle_id = worker()->call_in(std::chrono::milliseconds(MBED_CONF_SIMCOM_SIM800_HTTP_SESSION_IDLE_TIMEOUT),
+                                              this, &SIMCOM_SIM800_Bearer::http_idle);
+            if (_http_idle_id) {
+                return;
+            }
+#endif
+            http_idle();
+        }
+    }
+}
+
+void SIMCOM_SIM800_Bearer::http_idle()
+{
+    // Held across +HTTPTERM, so a new session cannot start before this one ends
+    ScopedLock<rtos::Mutex> lock(_http_mutex);
+    _http_idle_id = 0;
+    if (_http && _http_ref_count == 0) {
+        if (_http->is_session_open()) {
+            _http->close_session(0);
         }
+        delete _http;
+        _http = NULL;
     }
 }
 
@@ -24,17 +24,44 @@
 #include "ATHandler.h"
 #include "APN_db.h"
 #include "SIMCOM_SIM800_HTTP.h"
+#include "events/EventQueue.h"
+#include "rtos/Kernel.h"
+#include "rtos/Mutex.h"
+#include "rtos/Thread.h"
+#include <chrono>
 
 
 /*
-ToDO - spred CID through Bearer->(IP Apps). App shouldn't have posebility to change it.
-     - Add email App.
+ToDO - Add email App.
      - Add feature to port to SIM7070G
 
 */
 
 
 #define IPV4_ADDRESS_LENGTH 15
+#define BEARER_CID_MIN           1
+#define BEARER_CID_MAX           3          // SAPBR profiles supported by SIM800
+#define BEARER_QUERY_TIMEOUT     5000ms
+#define BEARER_OPEN_TIMEOUT      85000ms    // +SAPBR=1,1 worst case
+#define BEARER_OPEN_MIN_TIMEOUT  10000ms    // Adaptive open timeout never goes below, attach time varies widely
+
+#ifndef MBED_CONF_SIMCOM_SIM800_BEARER_STATUS_TTL
+#define MBED_CONF_SIMCOM_SIM800_BEARER_STATUS_TTL 30000
+#endif
+#ifndef MBED_CONF_SIMCOM_SIM800_HTTP_SESSION_IDLE_TIMEOUT
+#define MBED_CONF_SIMCOM_SIM800_HTTP_SESSION_IDLE_TIMEOUT 0
+#endif
+#ifndef MBED_CONF_SIMCOM_SIM800_BEARER_RECONNECT_MIN_DELAY
+#define MBED_CONF_SIMCOM_SIM800_BEARER_RECONNECT_MIN_DELAY 1000
+#endif
+#ifndef MBED_CONF_SIMCOM_SIM800_BEARER_RECONNECT_MAX_DELAY
+#define MBED_CONF_SIMCOM_SIM800_BEARER_RECONNECT_MAX_DELAY 60000
+#endif
+#ifndef MBED_CONF_SIMCOM_SIM800_BEARER_THREAD_STACK_SIZE
+#define MBED_CONF_SIMCOM_SIM800_BEARER_THREAD_STACK_SIZE 2048
+#endif
+
+#define BEARER_WORKER_EVENTS     4          // connect, disconnect, reconnect, HTTP idle
 
 typedef signed int gprs_cmd_t;
 typedef signed int gprs_status_t;
@@ -46,7 +73,16 @@ class ATHandler;
 /**
  * Class SIMCOM_SIM800_Bearer
  *
- * Class that provides ....
+ * Class that provides the SAPBR bearer used by the SIM800 IP applications.
+ * connect_async() opens the bearer from the device event queue, reports
+ * transitions to the status callback and reconnects with jittered
+ * exponential backoff after a +SAPBR <cid>: DEACT URC or a failed open.
+ * The device event queue must be dispatched for the asynchronous API.
+ * +SAPBR=1 can block for up to 85 s, so opening and closing run on a
+ * worker thread of the bearer, started on first use, and the device event
+ * queue stays free for URCs.
+ * One instance drives one SAPBR profile (CID 1-3), so up to three bearers,
+ * e.g. with different APNs, can be open at the same time.
  */
 class SIMCOM_SIM800_Bearer{
 public:
@@ -67,17 +103,80 @@ enum gprs_cmd
     get   = 4  //Get bearer parameters
 }; 
 
+typedef Callback<void(gprs_status_t)> bearer_status_cb_t;
+typedef Callback<void(const char *ipaddress)> bearer_ip_cb_t;
+
 public:
-    SIMCOM_SIM800_Bearer(AT_CellularDevice &device);
+    /** @param cid SAPBR profile 1-3, one instance per profile */
+    SIMCOM_SIM800_Bearer(AT_CellularDevice &device, int cid = BEARER_CID_MIN);
     
-    //~SIMCOM_SIM800_Bearer();
+    virtual ~SIMCOM_SIM800_Bearer();
 
     virtual nsapi_error_t setup_bearer();
+    /** Bearer status and IPv4 address. Served from the cache while it is younger
+     *  than bearer-status-ttl, otherwise refreshed with +SAPBR=2.
+     *
+     *  @param ipaddress buffer for the address, may be nullptr
+     *  @param length    size of ipaddress including terminator
+     *  @return gprs_status, closed if the modem could not be queried
+     */
     virtual gprs_status_t get_bearer_status(char* ipaddress=nullptr, size_t length = 0);
+
+    /** Query +SAPBR=2 now and update the cache. */
+    virtual gprs_status_t refresh_bearer_status(char* ipaddress=nullptr, size_t length = 0);
+
+    /** Cached status and address without any UART traffic. */
+    gprs_status_t cached_bearer_status(char* ipaddress=nullptr, size_t length = 0) const;
     virtual nsapi_error_t enable_bearer(bool onoff);
     void init_bearer(const char* apn, const char *uname, const char *pwd);
 
+    /** Register a callback for bearer state changes, called from the device event queue.
+     *
+     *  @param cb callback, nullptr to remove
+     */
+    void attach(bearer_status_cb_t cb);
+
+    /** Open the bearer without blocking the caller. The bearer is kept open,
+     *  reconnecting after drops, until disconnect_async().
+     *
+     *  @return NSAPI_ERROR_OK if the request was queued, NSAPI_ERROR_NO_MEMORY otherwise
+     */
+    nsapi_error_t connect_async();
+
+    /** Close the bearer without blocking the caller and stop reconnecting.
+     *
+     *  @return NSAPI_ERROR_OK if the request was queued, NSAPI_ERROR_NO_MEMORY otherwise
+     */
+    nsapi_error_t disconnect_async();
+
+    /** Last known bearer state (connecting, connected, closing, closed). */
+    gprs_status_t get_state() const;
+
+    /** SAPBR profile driven by this bearer. */
+    int get_cid() const;
+
+    /** Register a callback for IPv4 address changes, called from the device event queue.
+     *
+     *  @param cb callback, nullptr to remove
+     */
+    void attach_ip_change(bearer_ip_cb_t cb);
+
+    /** Release the HTTP service. With http-session-idle-timeout set, the last
+     *  release keeps the service and its modem session for that long, so the
+     *  next open_http() and init() cost no AT commands.
+     */
     void close_http();
+
+    /** Get the HTTP service bound to this bearer with the CID HTTPPARA.
+     *  The modem has a single HTTP service: an idle one kept by another
+     *  bearer is terminated first.
+     *
+     *  Each non-null return takes a reference that close_http() releases.
+     *  nullptr takes none and is not an error: retry once the other bearer
+     *  has closed the service.
+     *
+     *  @return nullptr while another bearer has the HTTP service open
+     */
     SIMCOM_SIM800_HTTP *open_http();
     SIMCOM_SIM800_HTTP *open_http_impl(ATHandler &at);
 
@@ -85,17 +184,55 @@ public:
 private:
 
 void set_credentials(const char *apn, const char *uname, const char *pwd);
+void set_state(gprs_status_t state);
+void set_ip(const char *ipaddress);
+void notify_ip();
+static void copy_ip(char *dst, size_t length, const char *src);
+void do_connect();
+void do_disconnect();
+void schedule_reconnect();
+events::EventQueue *worker();
+void urc_deact();
+void http_idle();
 
 private:
     const char *_apn;
     const char *_uname;
     const char *_pwd;
 
+    int                   _cid;
+    char                  _deact_urc[sizeof("+SAPBR 1: DEACT")];   // ATHandler keeps the pointer
     ATHandler            &_at;
     AT_CellularDevice    &_device;
     SIMCOM_SIM800_HTTP  *_http;
 
+    // Guarded by _http_mutex, the idle release runs on the worker thread
     int _http_ref_count = 0;
+    int _http_idle_id = 0;             // Event on _worker_queue
+
+    events::EventQueue  *_queue;
+    bearer_status_cb_t   _status_cb;
+    volatile gprs_status_t _state;
+    volatile bool        _keep_connected;   // connect_async() requested, reconnect on drops
+    int                  _reconnect_id;     // Event on _worker_queue
+    std::chrono::milliseconds _reconnect_delay;
+
+    // Status cache, refreshed by URCs, TTL expiry or on demand
+    bearer_ip_cb_t       _ip_cb;
+    char                 _ip[IPV4_ADDRESS_LENGTH + 1];
+    bool                 _status_valid;
+    rtos::Kernel::Clock::time_point _status_time;
+
+    // Blocking bearer commands, off the device event queue
+    rtos::Mutex          _mutex;
+    events::EventQueue   _worker_queue;
+    rtos::Thread         _worker;
+    bool                 _worker_started;
+
+    // Live bearer per CID, open_http() arbitrates the HTTP service between them
+    static SIMCOM_SIM800_Bearer *_profiles[BEARER_CID_MAX + 1];
+    // One HTTP service in the modem, shared by all profiles
+    static rtos::Mutex _http_mutex;
 };
 
 } // namespace mbed
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_CellularContext.h"
+#include "SIMCOM_SIM800_CellularStack.h"
+#include "SIMCOM_SIM800_ATBatch.h"
+#include "SIMCOM_SIM800_TransparentSocket.h"
+#include "CellularLog.h"
+
+using namespace mbed;
+using namespace std::chrono_literals;
+
+volatile bool SIMCOM_SIM800_CellularContext::_ip_context_owned = false;
+
+SIMCOM_SIM800_CellularContext::SIMCOM_SIM800_CellularContext(ATHandler &at, CellularDevice *device, const char *apn,
+                                                             bool cp_req, bool nonip_req):
+    AT_CellularContext(at, device, apn, cp_req, nonip_req)
+{
+
+}
+
+SIMCOM_SIM800_CellularContext::~SIMCOM_SIM800_CellularContext()
+{
+
+}
+
+bool SIMCOM_SIM800_CellularContext::is_ip_context_owned()
+{
+    return _ip_context_owned;
+}
+
+NetworkStack *SIMCOM_SIM800_CellularContext::get_stack()
+{
+    if (!_stack) {
+        _stack = new SIMCOM_SIM800_CellularStack(_at, _cid, (nsapi_ip_stack_t)_pdp_type, *get_device());
+    }
+    return _stack;
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularContext::shut_ip_context()
+{
+    _at.lock();
+    _at.set_at_timeout(SIM800_SHUT_TIMEOUT);
+    _at.cmd_start_stop("+CIPSHUT", "");
+    _at.resp_start("SHUT OK", true);
+    _at.resp_stop();
+    _at.restore_at_timeout();
+    return _at.unlock_return_error();
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularContext::open_ip_context()
+{
+    char ip[NSAPI_IPv4_SIZE];
+    SIMCOM_SIM800_ATBatch batch(_at);
+
+    // +CIPSHUT would drop the connection of a transparent socket
+    _at.lock();
+    if (SIMCOM_SIM800_TransparentSocket::is_in_use()) {
+        _at.unlock();
+        tr_warn("TCP/IP application in use by a transparent socket");
+        return NSAPI_ERROR_BUSY;
+    }
+    _ip_context_owned = true;
+    _at.unlock();
+
+    // CIPMODE, CIPMUX and CIPRXGET can only be changed in IP INITIAL state
+    nsapi_error_t err = shut_ip_context();
+    if (err != NSAPI_ERROR_OK) {
+        _ip_context_owned = false;
+        return err;
+    }
+
+    _at.lock();
+    // CIPMODE may be left at 1 by SIMCOM_SIM800_TransparentSocket
+    batch.add("+CIPMODE", "=", "%d", 0);
+    batch.add("+CIPMUX", "=", "%d", 1);
+    batch.add("+CIPRXGET", "=", "%d", 1);
+    batch.add("+CIPQSEND", "=", "%d", MBED_CONF_SIMCOM_SIM800_SOCKET_QUICK_SEND ? 1 : 0);
+    batch.add("+CSTT", "=", "%s%s%s", _apn, _uname, _pwd);
+    err = batch.get_last_error();
+    if (err == NSAPI_ERROR_OK) {
+        err = batch.execute();
+    }
+    if (err == NSAPI_ERROR_OK) {
+        _at.set_at_timeout(SIM800_CIICR_TIMEOUT);
+        err = _at.at_cmd_discard("+CIICR", "");
+        _at.restore_at_timeout();
+    }
+    if (err == NSAPI_ERROR_OK) {
+        // Reading the address moves the modem to IP STATUS, CIPSTART fails before that
+        err = _at.at_cmd_str("+CIFSREX", "", ip, sizeof(ip));
+        tr_info("IP context up, address %s", ip);
+    }
+    if (err != NSAPI_ERROR_OK) {
+        _ip_context_owned = false;
+    }
+    _at.unlock();
+    return err;
+}
+
+void SIMCOM_SIM800_CellularContext::do_connect()
+{
+    _cb_data.error = open_ip_context();
+    if (_cb_data.error != NSAPI_ERROR_OK) {
+        tr_error("IP context activation failed %d", _cb_data.error);
+        _is_connected = false;
+        call_network_cb(NSAPI_STATUS_DISCONNECTED);
+        return;
+    }
+    _is_context_active = true;
+    _is_connected = true;
+    call_network_cb(NSAPI_STATUS_GLOBAL_UP);
+}
+
+void SIMCOM_SIM800_CellularContext::deactivate_ip_context()
+{
+    shut_ip_context();
+    _ip_context_owned = false;
+    AT_CellularContext::deactivate_ip_context();
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_CELLULARCONTEXT_H_
+#define SIMCOM_SIM800_CELLULARCONTEXT_H_
+
+#include "AT_CellularContext.h"
+
+#define SIM800_CIICR_TIMEOUT 85000ms // AT+CIICR worst case
+#define SIM800_SHUT_TIMEOUT  65000ms // AT+CIPSHUT worst case
+
+#ifndef MBED_CONF_SIMCOM_SIM800_SOCKET_STACK
+#define MBED_CONF_SIMCOM_SIM800_SOCKET_STACK 0
+#endif
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_CellularContext
+ *
+ * Brings up the SIM800 TCP/IP application context (AT+CSTT, AT+CIICR,
+ * AT+CIFSREX) in multi-link, manual receive mode and provides
+ * SIMCOM_SIM800_CellularStack as the network stack.
+ */
+class SIMCOM_SIM800_CellularContext : public AT_CellularContext {
+public:
+    SIMCOM_SIM800_CellularContext(ATHandler &at, CellularDevice *device, const char *apn, bool cp_req = false,
+                                  bool nonip_req = false);
+    virtual ~SIMCOM_SIM800_CellularContext();
+
+    /** True from IP context activation until deactivation. The TCP/IP application
+     *  is then in multi-link mode, SIMCOM_SIM800_TransparentSocket refuses to connect.
+     */
+    static bool is_ip_context_owned();
+
+protected:
+    virtual NetworkStack *get_stack();
+    virtual void do_connect();
+    virtual void deactivate_ip_context();
+
+private:
+    nsapi_error_t open_ip_context();
+    nsapi_error_t shut_ip_context();
+
+    // One TCP/IP application in the modem, claimed under the AT lock
+    static volatile bool _ip_context_owned;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_CELLULARCONTEXT_H_
@@ -15,9 +15,9 @@
  * limitations under the License.
  */
 
-#include <stdio.h>
-
 #include "SIMCOM_SIM800_CellularInformation.h"
+#include "SIMCOM_SIM800_Parser.h"
+#include <string.h>
 
 namespace mbed {
 
@@ -27,18 +27,32 @@ SIMCOM_SIM800_CellularInformation::SIMCOM_SIM800_CellularInformation(ATHandler &
 
 nsapi_error_t SIMCOM_SIM800_CellularInformation::get_time(time_t *_time)
 {
-    char buf[32] = {0};
-    if (time == NULL) {
+    char buf[SIM800_RESPONSE_LINE_LENGTH] = {0};
+    if (_time == NULL) {
         return NSAPI_ERROR_PARAMETER;
     }
-    _at.at_cmd_str("+CCLK", "?", buf, sizeof(buf));
-    struct tm   t;
-    t.tm_isdst = 0;
+    //+CCLK: "yy/MM/dd,hh:mm:ss±zz"
+    _at.lock();
+    _at.cmd_start_stop("+CCLK", "?");
+    _at.resp_start("+CCLK:");
+    // The date and time are one quoted string, read past the ',' delimiter
+    _at.set_delimiter('\0');
+    _at.read_string(buf, sizeof(buf));
+    _at.set_default_delimiter();
+    _at.resp_stop();
+    nsapi_error_t err = _at.unlock_return_error();
+    if (err != NSAPI_ERROR_OK) {
+        return err;
+    }
+
+    struct tm t;
     int timezone;
-    sscanf(buf, "%d/%d/%d,%d:%d:%d+%d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec, &timezone);
-    t.tm_year = t.tm_year + 100;
-    t.tm_mon  = t.tm_mon - 1; 
-    *_time = mktime(&t);
+    if (!SIMCOM_SIM800_Parser::parse_clock(buf, strlen(buf), &t, &timezone)) {
+        tr_debug("Malformed +CCLK: %s", buf);
+        return NSAPI_ERROR_DEVICE_ERROR;
+    }
+    // Modem clock is local time, timezone in quarter hours east of UTC
+    *_time = mktime(&t) - timezone * 15 * 60;
     return NSAPI_ERROR_OK;
 }
 
@@ -38,6 +38,7 @@ public:
 
     //virtual nsapi_error_t get_location(char *buf, size_t buf_size);
 
+    /** Modem real time clock (+CCLK), converted to UTC with the reported timezone */
     virtual nsapi_error_t get_time(time_t *_time);
 };
 
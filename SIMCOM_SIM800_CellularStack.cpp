@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_CellularStack.h"
+#include "CellularLog.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace mbed;
+using namespace std::chrono_literals;
+
+static const char *const closed_urcs[SIM800_SOCKET_MAX] = {
+    "0, CLOSED", "1, CLOSED", "2, CLOSED", "3, CLOSED", "4, CLOSED", "5, CLOSED"
+};
+
+SIMCOM_SIM800_CellularStack::SIMCOM_SIM800_CellularStack(ATHandler &atHandler, int cid, nsapi_ip_stack_t stack_type,
+                                                         AT_CellularDevice &device):
+    AT_CellularStack(atHandler, cid, stack_type, device),
+    _tx_poll_id(0),
+    _dns(atHandler)
+{
+    for (int id = 0; id < SIM800_SOCKET_MAX; id++) {
+        reset_link(id);
+    }
+    _at.set_urc_handler("+CIPRXGET: 1,", mbed::Callback<void()>(this, &SIMCOM_SIM800_CellularStack::urc_ciprxget));
+    _at.set_urc_handler(closed_urcs[0], mbed::Callback<void()>(this, &SIMCOM_SIM800_CellularStack::urc_closed<0>));
+    _at.set_urc_handler(closed_urcs[1], mbed::Callback<void()>(this, &SIMCOM_SIM800_CellularStack::urc_closed<1>));
+    _at.set_urc_handler(closed_urcs[2], mbed::Callback<void()>(this, &SIMCOM_SIM800_CellularStack::urc_closed<2>));
+    _at.set_urc_handler(closed_urcs[3], mbed::Callback<void()>(this, &SIMCOM_SIM800_CellularStack::urc_closed<3>));
+    _at.set_urc_handler(closed_urcs[4], mbed::Callback<void()>(this, &SIMCOM_SIM800_CellularStack::urc_closed<4>));
+    _at.set_urc_handler(closed_urcs[5], mbed::Callback<void()>(this, &SIMCOM_SIM800_CellularStack::urc_closed<5>));
+}
+
+SIMCOM_SIM800_CellularStack::~SIMCOM_SIM800_CellularStack()
+{
+    if (_tx_poll_id) {
+        _device.get_queue()->cancel(_tx_poll_id);
+    }
+    _at.set_urc_handler("+CIPRXGET: 1,", nullptr);
+    for (int id = 0; id < SIM800_SOCKET_MAX; id++) {
+        _at.set_urc_handler(closed_urcs[id], nullptr);
+    }
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularStack::get_ip_address(SocketAddress *address)
+{
+    char ip[NSAPI_IPv4_SIZE];
+
+    // +CGPADDR does not cover the TCP/IP application context
+    nsapi_error_t err = _at.at_cmd_str("+CIFSREX", "", ip, sizeof(ip));
+    if (err != NSAPI_ERROR_OK) {
+        return err;
+    }
+    return address->set_ip_address(ip) ? NSAPI_ERROR_OK : NSAPI_ERROR_NO_ADDRESS;
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularStack::gethostbyname(const char *host, SocketAddress *address, nsapi_version_t version,
+                                                         const char *interface_name)
+{
+    char ip[DNS_IP_LENGTH];
+
+    if (version == NSAPI_IPv6) {
+        return NSAPI_ERROR_UNSUPPORTED;
+    }
+    // Literal addresses need no lookup
+    if (address->set_ip_address(host)) {
+        return NSAPI_ERROR_OK;
+    }
+    nsapi_error_t err = _dns.resolve(host, ip, sizeof(ip));
+    if (err != NSAPI_ERROR_OK) {
+        return err;
+    }
+    return address->set_ip_address(ip) ? NSAPI_ERROR_OK : NSAPI_ERROR_DNS_FAILURE;
+}
+
+SIMCOM_SIM800_DNS &SIMCOM_SIM800_CellularStack::get_dns()
+{
+    return _dns;
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularStack::socket_listen(nsapi_socket_t handle, int backlog)
+{
+    return NSAPI_ERROR_UNSUPPORTED;
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularStack::socket_accept(nsapi_socket_t server, nsapi_socket_t *handle, SocketAddress *address)
+{
+    return NSAPI_ERROR_UNSUPPORTED;
+}
+
+void SIMCOM_SIM800_CellularStack::reset_link(int id)
+{
+    _rx[id].reset();
+    _rx_pending[id] = false;
+    _link_closed[id] = false;
+    _tx_window[id] = 0;
+    _tx_blocked[id] = false;
+}
+
+void SIMCOM_SIM800_CellularStack::notify(int id)
+{
+    CellularSocket *socket = find_socket(id);
+    if (socket && socket->_cb) {
+        socket->_cb(socket->_data);
+    }
+}
+
+void SIMCOM_SIM800_CellularStack::urc_ciprxget()
+{
+    //+CIPRXGET: 1,<id>
+    int id = _at.read_int();
+    if (id < 0 || id >= SIM800_SOCKET_MAX) {
+        return;
+    }
+    _rx_pending[id] = true;
+    notify(id);
+}
+
+void SIMCOM_SIM800_CellularStack::link_closed(int id)
+{
+    tr_info("Socket %d closed by remote", id);
+    _link_closed[id] = true;
+    notify(id);
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularStack::create_socket_impl(CellularSocket *socket)
+{
+    // Link number is the socket id, pick the lowest one not in use
+    for (int id = 0; id < SIM800_SOCKET_MAX; id++) {
+        bool used = false;
+        for (int i = 0; i < _socket_count; i++) {
+            if (_socket[i] && _socket[i] != socket && _socket[i]->id == id) {
+                used = true;
+                break;
+            }
+        }
+        if (!used) {
+            socket->id = id;
+            socket->started = false;
+            reset_link(id);
+            return NSAPI_ERROR_OK;
+        }
+    }
+    return NSAPI_ERROR_NO_SOCKET;
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularStack::start_link(CellularSocket *socket, const SocketAddress &address)
+{
+    char prefix[16];
+    char result[16] = {0};
+    const int id = socket->id;
+
+    snprintf(prefix, sizeof(prefix), "%d, CONNECT", id);
+    reset_link(id);
+
+    _at.lock();
+    _at.at_cmd_discard("+CIPSTART", "=", "%d%s%s%d", id, socket->proto == NSAPI_TCP ? "TCP" : "UDP",
+                       address.get_ip_address(), address.get_port());
+    // OK only accepts the command, the link result follows as <n>, CONNECT OK/FAIL
+    _at.set_at_timeout(SIM800_CONNECT_TIMEOUT);
+    _at.resp_start(prefix, true);
+    _at.read_string(result, sizeof(result));
+    _at.resp_stop();
+    _at.restore_at_timeout();
+    nsapi_error_t err = _at.unlock_return_error();
+
+    if (err != NSAPI_ERROR_OK || strstr(result, "OK") == NULL) {
+        tr_warn("Socket %d connect failed: %s", id, result);
+        return err != NSAPI_ERROR_OK ? err : NSAPI_ERROR_NO_CONNECTION;
+    }
+    socket->remoteAddress = address;
+    socket->started = true;
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularStack::close_link(int id)
+{
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "%d, CLOSE OK", id);
+
+    _at.lock();
+    // Quick close, the modem does not wait for the remote FIN
+    _at.cmd_start_stop("+CIPCLOSE", "=", "%d%d", id, 1);
+    _at.resp_start(prefix, true);
+    _at.resp_stop();
+    return _at.unlock_return_error();
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularStack::socket_connect(nsapi_socket_t handle, const SocketAddress &address)
+{
+    CellularSocket *socket = (CellularSocket *)handle;
+    if (!socket) {
+        return NSAPI_ERROR_DEVICE_ERROR;
+    }
+    if (socket->connected) {
+        return NSAPI_ERROR_IS_CONNECTED;
+    }
+
+    _socket_mutex.lock();
+    nsapi_error_t err = NSAPI_ERROR_OK;
+    if (socket->id == -1) {
+        err = create_socket_impl(socket);
+    }
+    if (err == NSAPI_ERROR_OK) {
+        err = start_link(socket, address);
+    }
+    _socket_mutex.unlock();
+
+    if (err == NSAPI_ERROR_OK) {
+        socket->connected = true;
+    }
+    return err;
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularStack::socket_close_impl(int sock_id)
+{
+    CellularSocket *socket = find_socket(sock_id);
+    nsapi_error_t err = NSAPI_ERROR_OK;
+
+    if (socket && socket->started && !_link_closed[sock_id]) {
+        err = close_link(sock_id);
+    }
+    reset_link(sock_id);
+    return err;
+}
+
+nsapi_size_or_error_t SIMCOM_SIM800_CellularStack::socket_sendto_impl(CellularSocket *socket, const SocketAddress &address,
+                                                                      const void *data, nsapi_size_t size)
+{
+    const int id = socket->id;
+
+    if (socket->proto == NSAPI_TCP) {
+        if (!socket->started) {
+            return NSAPI_ERROR_NO_CONNECTION;
+        }
+        if (_link_closed[id]) {
+            return NSAPI_ERROR_CONNECTION_LOST;
+        }
+    } else if (!socket->started || _link_closed[id] || socket->remoteAddress != address) {
+        // A UDP link is bound to one remote, move it for sendto() elsewhere
+        if (socket->started && !_link_closed[id]) {
+            close_link(id);
+        }
+        socket->started = false;
+        nsapi_error_t err = start_link(socket, address);
+        if (err != NSAPI_ERROR_OK) {
+            return err;
+        }
+    }
+
+    if (size > SIM800_MAX_SEND_SIZE) {
+        size = SIM800_MAX_SEND_SIZE;
+    }
+
+#if MBED_CONF_SIMCOM_SIM800_SOCKET_QUICK_SEND
+    if (_tx_window[id] < (int)size) {
+        refresh_tx_window();
+    }
+    if (_tx_window[id] <= 0) {
+        // Backpressure: the modem buffer is full of data not yet sent
+        _tx_blocked[id] = true;
+        if (!_tx_poll_id) {
+            _tx_poll_id = _device.get_queue()->call_in(SIM800_TX_POLL_INTERVAL, this, &SIMCOM_SIM800_CellularStack::tx_poll);
+        }
+        return NSAPI_ERROR_WOULD_BLOCK;
+    }
+    if ((int)size > _tx_window[id]) {
+        size = _tx_window[id];
+    }
+#endif
+
+    char prefix[16];
+    char result[16] = {0};
+    int accepted = size;
+#if MBED_CONF_SIMCOM_SIM800_SOCKET_QUICK_SEND
+    snprintf(prefix, sizeof(prefix), "DATA ACCEPT:");
+#else
+    snprintf(prefix, sizeof(prefix), "%d, SEND", id);
+#endif
+
+    _at.set_at_timeout(SIM800_SEND_TIMEOUT);
+    _at.cmd_start_stop("+CIPSEND", "=", "%d%d", id, size);
+    _at.resp_start(">", true);
+    _at.write_bytes((const uint8_t *)data, size);
+    _at.resp_start(prefix, true);
+#if MBED_CONF_SIMCOM_SIM800_SOCKET_QUICK_SEND
+    // DATA ACCEPT:<n>,<length>, the bytes are in the modem buffer
+    _at.skip_param();
+    accepted = _at.read_int();
+    strcpy(result, accepted > 0 ? "OK" : "");
+#else
+    // <n>, SEND OK or <n>, SEND FAIL
+    _at.read_string(result, sizeof(result));
+#endif
+    _at.resp_stop();
+    _at.restore_at_timeout();
+
+    if (_at.get_last_error() != NSAPI_ERROR_OK || strstr(result, "OK") == NULL) {
+        tr_warn("Socket %d send failed: %s", id, result);
+        return NSAPI_ERROR_DEVICE_ERROR;
+    }
+#if MBED_CONF_SIMCOM_SIM800_SOCKET_QUICK_SEND
+    _tx_window[id] -= accepted;
+#endif
+    return accepted;
+}
+
+nsapi_error_t SIMCOM_SIM800_CellularStack::refresh_tx_window()
+{
+    //+CIPSEND: <n>,<size> for every link
+    _at.lock();
+    _at.cmd_start_stop("+CIPSEND", "?");
+    _at.resp_start("+CIPSEND:");
+    while (_at.info_resp()) {
+        int id = _at.read_int();
+        int size = _at.read_int();
+        if (id >= 0 && id < SIM800_SOCKET_MAX) {
+            _tx_window[id] = size;
+        }
+    }
+    _at.resp_stop();
+    return _at.unlock_return_error();
+}
+
+void SIMCOM_SIM800_CellularStack::tx_poll()
+{
+    bool blocked = false;
+
+    _tx_poll_id = 0;
+    refresh_tx_window();
+    for (int id = 0; id < SIM800_SOCKET_MAX; id++) {
+        if (!_tx_blocked[id]) {
+            continue;
+        }
+        if (_tx_window[id] > 0 || _link_closed[id]) {
+            _tx_blocked[id] = false;
+            notify(id);
+        } else {
+            blocked = true;
+        }
+    }
+    if (blocked) {
+        _tx_poll_id = _device.get_queue()->call_in(SIM800_TX_POLL_INTERVAL, this, &SIMCOM_SIM800_CellularStack::tx_poll);
+    }
+}
+
+nsapi_size_or_error_t SIMCOM_SIM800_CellularStack::pull(int id, uint8_t *buf, size_t len)
+{
+    if (len > SIM800_MAX_RECV_SIZE) {
+        len = SIM800_MAX_RECV_SIZE;
+    }
+
+    //+CIPRXGET: 2,<id>,<reqlength>,<cnflength>
+    _at.cmd_start_stop("+CIPRXGET", "=", "%d%d%d", 2, id, len);
+    _at.resp_start("+CIPRXGET: 2,");
+    _at.skip_param();
+    int got = _at.read_int();
+    int left = _at.read_int();
+    if (got > 0) {
+        if ((size_t)got > len) {
+            got = len;
+        }
+        _at.read_bytes(buf, got);
+    }
+    _at.resp_stop();
+
+    if (_at.get_last_error() != NSAPI_ERROR_OK || got < 0) {
+        return NSAPI_ERROR_DEVICE_ERROR;
+    }
+    // The modem announces new data with another URC once this drains
+    _rx_pending[id] = left > 0;
+    return got;
+}
+
+nsapi_size_or_error_t SIMCOM_SIM800_CellularStack::socket_recvfrom_impl(CellularSocket *socket, SocketAddress *address,
+                                                                        void *buffer, nsapi_size_t size)
+{
+    const int id = socket->id;
+    uint8_t *dst = (uint8_t *)buffer;
+    nsapi_size_or_error_t got = 0;
+    size_t n = 0;
+
+    if (socket->proto == NSAPI_UDP) {
+        // One pull per datagram, the buffer would merge them
+        if (_rx_pending[id]) {
+            got = pull(id, dst, size);
+            if (got > 0) {
+                n = got;
+            }
+        }
+    } else {
+        n = _rx[id].pop(dst, size);
+        if (n < size && _rx_pending[id]) {
+            size_t want = size - n;
+            if (want >= sizeof(_scratch)) {
+                got = pull(id, dst + n, want);
+                if (got > 0) {
+                    n += got;
+                }
+            } else {
+                // Small read, refill the buffer so the next reads need no AT command
+                got = pull(id, _scratch, sizeof(_scratch));
+                if (got > 0) {
+                    _rx[id].push(_scratch, got);
+                    n += _rx[id].pop(dst + n, want);
+                }
+            }
+        }
+    }
+
+    if (n == 0) {
+        if (got < 0) {
+            return got;
+        }
+        // Remote close is reported as end of stream once the buffer is empty
+        return _link_closed[id] ? 0 : NSAPI_ERROR_WOULD_BLOCK;
+    }
+    if (address) {
+        *address = socket->remoteAddress;
+    }
+    return n;
+}
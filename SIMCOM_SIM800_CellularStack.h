@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_CELLULARSTACK_H_
+#define SIMCOM_SIM800_CELLULARSTACK_H_
+
+#include "AT_CellularStack.h"
+#include "SIMCOM_SIM800_DNS.h"
+#include "platform/CircularBuffer.h"
+#include <chrono>
+
+#define SIM800_SOCKET_MAX       6
+#define SIM800_MAX_SEND_SIZE    1460    // AT+CIPSEND limit per command
+#define SIM800_MAX_RECV_SIZE    1460    // AT+CIPRXGET=2 limit per command
+#define SIM800_CONNECT_TIMEOUT  75000ms // AT+CIPSTART until <n>, CONNECT OK/FAIL
+#define SIM800_SEND_TIMEOUT     10000ms
+#define SIM800_TX_POLL_INTERVAL 200ms   // Free buffer polling while a quick-send link is full
+
+#ifndef MBED_CONF_SIMCOM_SIM800_SOCKET_QUICK_SEND
+#define MBED_CONF_SIMCOM_SIM800_SOCKET_QUICK_SEND 0
+#endif
+#ifndef MBED_CONF_SIMCOM_SIM800_SOCKET_RX_BUFFER_SIZE
+#define MBED_CONF_SIMCOM_SIM800_SOCKET_RX_BUFFER_SIZE 256
+#endif
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_CellularStack
+ *
+ * Socket stack on the SIM800 TCP/IP application in multi-link mode
+ * (AT+CIPMUX=1) with manual receive (AT+CIPRXGET=1). The modem holds incoming
+ * data and announces it with +CIPRXGET: 1,<n>, which only triggers the socket
+ * sigio. Data is pulled with AT+CIPRXGET=2 when the application reads, so six
+ * links share the UART without unsolicited data.
+ *
+ * Small TCP reads are served from a per-link buffer of socket-rx-buffer-size
+ * bytes that is refilled in one pull. UDP datagrams bypass it.
+ *
+ * With socket-quick-send the context enables AT+CIPQSEND=1 and a send
+ * completes on DATA ACCEPT, when the bytes are in the modem buffer, instead
+ * of SEND OK after the server acknowledged them. Sends are bounded by the
+ * free buffer space reported by AT+CIPSEND?; a full link returns
+ * NSAPI_ERROR_WOULD_BLOCK and its sigio fires once space is available.
+ */
+class SIMCOM_SIM800_CellularStack : public AT_CellularStack {
+public:
+    SIMCOM_SIM800_CellularStack(ATHandler &atHandler, int cid, nsapi_ip_stack_t stack_type, AT_CellularDevice &device);
+    virtual ~SIMCOM_SIM800_CellularStack();
+
+    virtual nsapi_error_t get_ip_address(SocketAddress *address);
+
+    /** Resolve with AT+CDNSGIP through the SIMCOM_SIM800_DNS cache. */
+    virtual nsapi_error_t gethostbyname(const char *host, SocketAddress *address, nsapi_version_t version = NSAPI_UNSPEC,
+                                        const char *interface_name = NULL);
+
+    SIMCOM_SIM800_DNS &get_dns();
+
+protected: // NetworkStack
+    virtual nsapi_error_t socket_listen(nsapi_socket_t handle, int backlog);
+    virtual nsapi_error_t socket_accept(nsapi_socket_t server, nsapi_socket_t *handle, SocketAddress *address = 0);
+    virtual nsapi_error_t socket_connect(nsapi_socket_t handle, const SocketAddress &address);
+
+protected: // AT_CellularStack
+    virtual nsapi_error_t socket_close_impl(int sock_id);
+    virtual nsapi_error_t create_socket_impl(CellularSocket *socket);
+    virtual nsapi_size_or_error_t socket_sendto_impl(CellularSocket *socket, const SocketAddress &address,
+                                                     const void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t socket_recvfrom_impl(CellularSocket *socket, SocketAddress *address,
+                                                       void *buffer, nsapi_size_t size);
+
+private:
+    nsapi_error_t start_link(CellularSocket *socket, const SocketAddress &address);
+    nsapi_error_t close_link(int id);
+    nsapi_size_or_error_t pull(int id, uint8_t *buf, size_t len);
+    nsapi_error_t refresh_tx_window();
+    void tx_poll();
+    void reset_link(int id);
+    void notify(int id);
+
+    void urc_ciprxget();
+    void link_closed(int id);
+    template <int id> void urc_closed()
+    {
+        link_closed(id);
+    }
+
+    typedef CircularBuffer<uint8_t, MBED_CONF_SIMCOM_SIM800_SOCKET_RX_BUFFER_SIZE> rx_buffer_t;
+
+    rx_buffer_t    _rx[SIM800_SOCKET_MAX];
+    volatile bool  _rx_pending[SIM800_SOCKET_MAX];  // Modem holds data, set by +CIPRXGET: 1
+    volatile bool  _link_closed[SIM800_SOCKET_MAX]; // Remote closed, buffered data is still readable
+    int            _tx_window[SIM800_SOCKET_MAX];   // Quick send: bytes the modem can still accept
+    bool           _tx_blocked[SIM800_SOCKET_MAX];  // Quick send: a send returned WOULD_BLOCK
+    int            _tx_poll_id;
+    SIMCOM_SIM800_DNS _dns;
+    uint8_t        _scratch[MBED_CONF_SIMCOM_SIM800_SOCKET_RX_BUFFER_SIZE]; // Refill staging, used under the AT lock
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_CELLULARSTACK_H_
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_DNS.h"
+#include "CellularLog.h"
+#include "platform/ScopedLock.h"
+#include <string.h>
+#include <strings.h>
+
+using namespace mbed;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+SIMCOM_SIM800_DNS::SIMCOM_SIM800_DNS(ATHandler &at):
+    _at(at),
+    _use_counter(0),
+    _done_generation(0),
+    _done_err(NSAPI_ERROR_OK),
+    _cond(_mutex)
+{
+    for (int i = 0; i < MBED_CONF_SIMCOM_SIM800_DNS_CACHE_SIZE; i++) {
+        _cache[i].used = false;
+    }
+    _lookup.active = false;
+    _lookup.generation = 0;
+    _lookup.waiter_count = 0;
+    _done_ip[0] = '\0';
+    memset(&_stats, 0, sizeof(_stats));
+    _at.set_urc_handler("+CDNSGIP:", mbed::Callback<void()>(this, &SIMCOM_SIM800_DNS::urc_cdnsgip));
+}
+
+SIMCOM_SIM800_DNS::~SIMCOM_SIM800_DNS()
+{
+    _at.set_urc_handler("+CDNSGIP:", nullptr);
+}
+
+void SIMCOM_SIM800_DNS::flush_cache()
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    for (int i = 0; i < MBED_CONF_SIMCOM_SIM800_DNS_CACHE_SIZE; i++) {
+        _cache[i].used = false;
+    }
+}
+
+void SIMCOM_SIM800_DNS::get_stats(dns_stats_t *stats)
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    *stats = _stats;
+}
+
+bool SIMCOM_SIM800_DNS::cache_lookup(const char *host, char *ip, size_t len)
+{
+    rtos::Kernel::Clock::time_point now = rtos::Kernel::Clock::now();
+    for (int i = 0; i < MBED_CONF_SIMCOM_SIM800_DNS_CACHE_SIZE; i++) {
+        dns_entry_t &e = _cache[i];
+        if (!e.used || strcasecmp(e.host, host) != 0) {
+            continue;
+        }
+        if (now >= e.expires) {
+            e.used = false;
+            return false;
+        }
+        e.last_used = ++_use_counter;
+        if (ip) {
+            strncpy(ip, e.ip, len - 1);
+            ip[len - 1] = '\0';
+        }
+        return true;
+    }
+    return false;
+}
+
+void SIMCOM_SIM800_DNS::cache_store(const char *host, const char *ip)
+{
+    dns_entry_t *slot = nullptr;
+    for (int i = 0; i < MBED_CONF_SIMCOM_SIM800_DNS_CACHE_SIZE; i++) {
+        dns_entry_t &e = _cache[i];
+        if (!e.used || strcasecmp(e.host, host) == 0) {
+            slot = &e;
+            break;
+        }
+        if (!slot || e.last_used < slot->last_used) {
+            slot = &e;
+        }
+    }
+    if (slot->used && strcasecmp(slot->host, host) != 0) {
+        _stats.evictions++;
+    }
+    slot->used = true;
+    strncpy(slot->host, host, sizeof(slot->host) - 1);
+    slot->host[sizeof(slot->host) - 1] = '\0';
+    strncpy(slot->ip, ip, sizeof(slot->ip) - 1);
+    slot->ip[sizeof(slot->ip) - 1] = '\0';
+    slot->expires = rtos::Kernel::Clock::now() + milliseconds(MBED_CONF_SIMCOM_SIM800_DNS_CACHE_TTL);
+    slot->last_used = ++_use_counter;
+}
+
+nsapi_error_t SIMCOM_SIM800_DNS::start_lookup(const char *host)
+{
+    // Called with _mutex held
+    if (strlen(host) >= DNS_HOST_LENGTH) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+    _lookup.active = true;
+    _lookup.generation++;
+    strcpy(_lookup.host, host);
+    _lookup.waiter_count = 0;
+    _lookup.deadline = rtos::Kernel::Clock::now() + DNS_TIMEOUT;
+    _stats.misses++;
+    return NSAPI_ERROR_OK;
+}
+
+void SIMCOM_SIM800_DNS::send_lookup()
+{
+    // The host is copied because a timed out lookup may be replaced meanwhile
+    char host[DNS_HOST_LENGTH];
+    _mutex.lock();
+    uint32_t generation = _lookup.generation;
+    strcpy(host, _lookup.host);
+    _mutex.unlock();
+
+    nsapi_error_t err = _at.at_cmd_discard("+CDNSGIP", "=", "%s", host);
+    if (err != NSAPI_ERROR_OK) {
+        _mutex.lock();
+        if (_lookup.active && _lookup.generation == generation) {
+            complete(NSAPI_ERROR_DNS_FAILURE, nullptr);
+        }
+        _mutex.unlock();
+    }
+}
+
+void SIMCOM_SIM800_DNS::complete(nsapi_error_t err, const char *ip)
+{
+    // Called with _mutex held
+    if (err == NSAPI_ERROR_OK) {
+        cache_store(_lookup.host, ip);
+    } else {
+        _stats.failures++;
+    }
+    _lookup.active = false;
+    _done_generation = _lookup.generation;
+    _done_err = err;
+    strncpy(_done_ip, err == NSAPI_ERROR_OK ? ip : "", sizeof(_done_ip) - 1);
+    _done_ip[sizeof(_done_ip) - 1] = '\0';
+
+    for (int i = 0; i < _lookup.waiter_count; i++) {
+        _lookup.waiters[i](err, _done_ip);
+        _lookup.waiters[i] = nullptr;
+    }
+    _lookup.waiter_count = 0;
+    _cond.notify_all();
+}
+
+void SIMCOM_SIM800_DNS::urc_cdnsgip()
+{
+    //+CDNSGIP: 1,"<domain>","<ip1>"[,"<ip2>"] or +CDNSGIP: 0,<dns error code>
+    char host[DNS_HOST_LENGTH] = {0};
+    char ip[DNS_IP_LENGTH] = {0};
+    int ok = _at.read_int();
+    if (ok == 1) {
+        _at.read_string(host, sizeof(host));
+        _at.read_string(ip, sizeof(ip));
+    } else {
+        tr_debug("DNS error %d", _at.read_int());
+    }
+
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    if (!_lookup.active) {
+        return;
+    }
+    if (ok == 1 && strcasecmp(host, _lookup.host) == 0 && ip[0]) {
+        complete(NSAPI_ERROR_OK, ip);
+    } else if (ok != 1) {
+        complete(NSAPI_ERROR_DNS_FAILURE, nullptr);
+    }
+}
+
+nsapi_error_t SIMCOM_SIM800_DNS::resolve_async(const char *host, dns_cb_t cb)
+{
+    char ip[DNS_IP_LENGTH];
+    bool send = false;
+
+    _mutex.lock();
+    if (cache_lookup(host, ip, sizeof(ip))) {
+        _stats.hits++;
+        _mutex.unlock();
+        cb(NSAPI_ERROR_OK, ip);
+        return NSAPI_ERROR_OK;
+    }
+    if (_lookup.active && rtos::Kernel::Clock::now() >= _lookup.deadline) {
+        complete(NSAPI_ERROR_TIMEOUT, nullptr);
+    }
+    nsapi_error_t err = NSAPI_ERROR_OK;
+    if (_lookup.active && strcasecmp(_lookup.host, host) != 0) {
+        err = NSAPI_ERROR_BUSY;
+    } else if (_lookup.waiter_count >= DNS_MAX_WAITERS) {
+        err = NSAPI_ERROR_BUSY;
+    } else {
+        if (_lookup.active) {
+            _stats.coalesced++;
+        } else {
+            err = start_lookup(host);
+            send = (err == NSAPI_ERROR_OK);
+        }
+        if (err == NSAPI_ERROR_OK) {
+            _lookup.waiters[_lookup.waiter_count++] = cb;
+        }
+    }
+    _mutex.unlock();
+
+    if (send) {
+        send_lookup();
+    }
+    return err;
+}
+
+nsapi_error_t SIMCOM_SIM800_DNS::resolve(const char *host, char *ip, size_t len)
+{
+    uint32_t generation;
+    bool send = false;
+
+    _mutex.lock();
+    while (true) {
+        if (cache_lookup(host, ip, len)) {
+            _stats.hits++;
+            _mutex.unlock();
+            return NSAPI_ERROR_OK;
+        }
+        if (_lookup.active && rtos::Kernel::Clock::now() >= _lookup.deadline) {
+            complete(NSAPI_ERROR_TIMEOUT, nullptr);
+        }
+        if (!_lookup.active) {
+            nsapi_error_t err = start_lookup(host);
+            if (err != NSAPI_ERROR_OK) {
+                _mutex.unlock();
+                return err;
+            }
+            send = true;
+            break;
+        }
+        if (strcasecmp(_lookup.host, host) == 0) {
+            _stats.coalesced++;
+            break;
+        }
+        // Another host is being resolved, wait for it to finish
+        _cond.wait_until(_lookup.deadline);
+    }
+    generation = _lookup.generation;
+    _mutex.unlock();
+
+    if (send) {
+        send_lookup();
+    }
+
+    _mutex.lock();
+    while (_done_generation != generation) {
+        if (_cond.wait_until(_lookup.deadline) == rtos::cv_status::timeout && _done_generation != generation) {
+            if (_lookup.active && _lookup.generation == generation) {
+                complete(NSAPI_ERROR_TIMEOUT, nullptr);
+            }
+            break;
+        }
+    }
+    nsapi_error_t err = (_done_generation == generation) ? _done_err : NSAPI_ERROR_TIMEOUT;
+    if (err == NSAPI_ERROR_OK) {
+        strncpy(ip, _done_ip, len - 1);
+        ip[len - 1] = '\0';
+    }
+    _mutex.unlock();
+    return err;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_DNS_H_
+#define SIMCOM_SIM800_DNS_H_
+
+#include "ATHandler.h"
+#include "rtos/ConditionVariable.h"
+#include "rtos/Kernel.h"
+#include "rtos/Mutex.h"
+#include <chrono>
+#include <stdint.h>
+
+#define DNS_HOST_LENGTH   64
+#define DNS_IP_LENGTH     16
+#define DNS_MAX_WAITERS   4         // Asynchronous callbacks coalesced on one lookup
+#define DNS_TIMEOUT       20000ms   // AT+CDNSGIP until the +CDNSGIP URC
+
+#ifndef MBED_CONF_SIMCOM_SIM800_DNS_CACHE_SIZE
+#define MBED_CONF_SIMCOM_SIM800_DNS_CACHE_SIZE 4
+#endif
+#ifndef MBED_CONF_SIMCOM_SIM800_DNS_CACHE_TTL
+#define MBED_CONF_SIMCOM_SIM800_DNS_CACHE_TTL 300000
+#endif
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_DNS
+ *
+ * Hostname resolver on AT+CDNSGIP. The result arrives in a +CDNSGIP URC.
+ * Answers are kept in a dns-cache-size entry LRU cache for dns-cache-ttl ms.
+ * One lookup runs at a time. Requests for the host being looked up wait for
+ * that lookup instead of sending another one.
+ * Needs an active IP context (AT+CIICR).
+ */
+class SIMCOM_SIM800_DNS {
+public:
+    /** Result of an asynchronous lookup. ip is only valid during the call.
+     *  Called from the ATHandler URC context or, on a cache hit, from
+     *  resolve_async(), so it must not issue AT commands.
+     */
+    typedef Callback<void(nsapi_error_t err, const char *ip)> dns_cb_t;
+
+    typedef struct dns_stats
+    {
+    unsigned int  hits;        // Served from the cache
+    unsigned int  misses;      // Sent AT+CDNSGIP
+    unsigned int  coalesced;   // Joined a lookup already in flight
+    unsigned int  failures;    // Lookups that failed or timed out
+    unsigned int  evictions;   // Live entries replaced by LRU
+    }dns_stats_t;
+
+    SIMCOM_SIM800_DNS(ATHandler &at);
+    virtual ~SIMCOM_SIM800_DNS();
+
+    /** Resolve host to a dotted IPv4 address, blocking.
+     *
+     *  @param ip     buffer of at least DNS_IP_LENGTH bytes
+     *  @return NSAPI_ERROR_OK, NSAPI_ERROR_DNS_FAILURE or NSAPI_ERROR_TIMEOUT
+     */
+    nsapi_error_t resolve(const char *host, char *ip, size_t len);
+
+    /** Resolve host without blocking.
+     *
+     *  @return NSAPI_ERROR_OK if the callback was called or will be called,
+     *          NSAPI_ERROR_BUSY if another host is being looked up or no waiter slot is free
+     */
+    nsapi_error_t resolve_async(const char *host, dns_cb_t cb);
+
+    void flush_cache();
+    void get_stats(dns_stats_t *stats);
+
+private:
+    typedef struct dns_entry
+    {
+    bool                      used;
+    char                      host[DNS_HOST_LENGTH];
+    char                      ip[DNS_IP_LENGTH];
+    rtos::Kernel::Clock::time_point expires;
+    uint32_t                  last_used;
+    }dns_entry_t;
+
+    typedef struct dns_lookup
+    {
+    bool                      active;
+    uint32_t                  generation;  // Incremented by every lookup
+    char                      host[DNS_HOST_LENGTH];
+    dns_cb_t                  waiters[DNS_MAX_WAITERS];
+    int                       waiter_count;
+    rtos::Kernel::Clock::time_point deadline;
+    }dns_lookup_t;
+
+    bool cache_lookup(const char *host, char *ip, size_t len);
+    void cache_store(const char *host, const char *ip);
+    nsapi_error_t start_lookup(const char *host);
+    void send_lookup();
+    void complete(nsapi_error_t err, const char *ip);
+    void urc_cdnsgip();
+
+    ATHandler            &_at;
+    dns_entry_t           _cache[MBED_CONF_SIMCOM_SIM800_DNS_CACHE_SIZE];
+    uint32_t              _use_counter;
+    dns_lookup_t          _lookup;
+
+    // Result of the last completed lookup, read by blocking waiters
+    uint32_t              _done_generation;
+    nsapi_error_t         _done_err;
+    char                  _done_ip[DNS_IP_LENGTH];
+
+    dns_stats_t           _stats;
+
+    // Never held while issuing AT commands, the URC takes it under the AT lock
+    rtos::Mutex           _mutex;
+    rtos::ConditionVariable _cond;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_DNS_H_
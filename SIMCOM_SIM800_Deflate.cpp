@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_Deflate.h"
+#include <string.h>
+
+using namespace mbed;
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// OS field 0xFF: unknown
+static const uint8_t gzip_header[GZIP_HEADER_LENGTH] = {0x1F, 0x8B, 0x08, 0x00, 0, 0, 0, 0, 0x00, 0xFF};
+
+SIMCOM_SIM800_Deflate::SIMCOM_SIM800_Deflate()
+{
+    begin(nullptr, 0);
+}
+
+void SIMCOM_SIM800_Deflate::begin(const void *data, size_t len)
+{
+    _in = (const uint8_t *)data;
+    _len = len;
+    _pos = 0;
+    _stage = STAGE_HEADER;
+    _frame_pos = 0;
+    _bits = 0;
+    _bitcount = 0;
+    _crc = crc32(0, _in, _len);
+    memset(_head, 0, sizeof(_head));
+}
+
+bool SIMCOM_SIM800_Deflate::finished() const
+{
+    return _stage == STAGE_DONE && _bitcount == 0;
+}
+
+size_t SIMCOM_SIM800_Deflate::compressed_size(const void *data, size_t len)
+{
+    uint8_t scratch[32];
+    size_t total = 0;
+    ssize_t n;
+
+    begin(data, len);
+    while ((n = read(scratch, sizeof(scratch))) > 0) {
+        total += n;
+    }
+    begin(data, len);
+    return total;
+}
+
+ssize_t SIMCOM_SIM800_Deflate::read(uint8_t *buf, size_t len)
+{
+    size_t n = 0;
+
+    while (n < len) {
+        if (_bitcount >= 8) {
+            buf[n++] = _bits & 0xFF;
+            _bits >>= 8;
+            _bitcount -= 8;
+        } else if (_stage == STAGE_DONE) {
+            break;
+        } else {
+            // Adds at most 39 bits
+            encode_next();
+        }
+    }
+    return n;
+}
+
+void SIMCOM_SIM800_Deflate::put_bits(uint32_t value, int count)
+{
+    _bits |= (uint64_t)value << _bitcount;
+    _bitcount += count;
+}
+
+void SIMCOM_SIM800_Deflate::put_huffman(uint32_t code, int count)
+{
+    // Huffman codes are packed starting with the most significant bit
+    uint32_t reversed = 0;
+    for (int i = 0; i < count; i++) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    put_bits(reversed, count);
+}
+
+void SIMCOM_SIM800_Deflate::put_symbol(int symbol)
+{
+    // Fixed literal/length code, RFC 1951 3.2.6
+    if (symbol < 144) {
+        put_huffman(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        put_huffman(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        put_huffman(symbol - 256, 7);
+    } else {
+        put_huffman(0xC0 + symbol - 280, 8);
+    }
+}
+
+void SIMCOM_SIM800_Deflate::put_match(size_t length, size_t distance)
+{
+    int code = 28;
+    while (length_base[code] > length) {
+        code--;
+    }
+    put_symbol(257 + code);
+    put_bits(length - length_base[code], length_extra[code]);
+
+    code = 29;
+    while (distance_base[code] > distance) {
+        code--;
+    }
+    put_huffman(code, 5);
+    put_bits(distance - distance_base[code], distance_extra[code]);
+}
+
+uint32_t SIMCOM_SIM800_Deflate::hash(const uint8_t *p)
+{
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+void SIMCOM_SIM800_Deflate::encode_next()
+{
+    switch (_stage) {
+    case STAGE_HEADER:
+        put_bits(gzip_header[_frame_pos++], 8);
+        if (_frame_pos == GZIP_HEADER_LENGTH) {
+            // BFINAL = 1, BTYPE = 01 fixed Huffman
+            put_bits(1, 1);
+            put_bits(1, 2);
+            _stage = STAGE_BLOCK;
+        }
+        break;
+
+    case STAGE_BLOCK: {
+        if (_pos >= _len) {
+            put_symbol(256);
+            // The trailer starts on a byte boundary
+            put_bits(0, (8 - (_bitcount & 7)) & 7);
+            _stage = STAGE_TRAILER;
+            _frame_pos = 0;
+            break;
+        }
+
+        size_t best = 0;
+        size_t distance = 0;
+        if (_pos + DEFLATE_MIN_MATCH <= _len) {
+            uint32_t h = hash(_in + _pos);
+            uint32_t candidate = _head[h];
+            _head[h] = _pos + 1;
+            if (candidate && _pos - (candidate - 1) <= MBED_CONF_SIMCOM_SIM800_COMPRESSION_WINDOW) {
+                const uint8_t *a = _in + candidate - 1;
+                const uint8_t *b = _in + _pos;
+                size_t max = _len - _pos;
+                if (max > DEFLATE_MAX_MATCH) {
+                    max = DEFLATE_MAX_MATCH;
+                }
+                while (best < max && a[best] == b[best]) {
+                    best++;
+                }
+                distance = b - a;
+            }
+        }
+
+        if (best >= DEFLATE_MIN_MATCH) {
+            put_match(best, distance);
+            // Index the covered positions so later data can refer to them
+            for (size_t i = 1; i < best && _pos + i + DEFLATE_MIN_MATCH <= _len; i++) {
+                _head[hash(_in + _pos + i)] = _pos + i + 1;
+            }
+            _pos += best;
+        } else {
+            put_symbol(_in[_pos++]);
+        }
+        break;
+    }
+
+    case STAGE_TRAILER:
+        // CRC-32 then ISIZE, both little endian
+        if (_frame_pos < 4) {
+            put_bits((_crc >> (8 * _frame_pos)) & 0xFF, 8);
+        } else {
+            put_bits(((uint32_t)_len >> (8 * (_frame_pos - 4))) & 0xFF, 8);
+        }
+        if (++_frame_pos == GZIP_TRAILER_LENGTH) {
+            _stage = STAGE_DONE;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+uint32_t SIMCOM_SIM800_Deflate::crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    // Nibble table, 64 bytes instead of 1 KB
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_DEFLATE_H_
+#define SIMCOM_SIM800_DEFLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifndef MBED_CONF_SIMCOM_SIM800_COMPRESSION_WINDOW
+#define MBED_CONF_SIMCOM_SIM800_COMPRESSION_WINDOW 4096
+#endif
+
+#define DEFLATE_HASH_BITS   8
+#define DEFLATE_MIN_MATCH   3
+#define DEFLATE_MAX_MATCH   258
+#define GZIP_HEADER_LENGTH  10
+#define GZIP_TRAILER_LENGTH 8
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_Deflate
+ *
+ * Streaming gzip (RFC 1952) compressor for request bodies already in RAM.
+ * A single fixed-Huffman deflate block is produced with greedy LZ77 matching
+ * against the input itself, so the only state is a 1 KB hash table.
+ * Matches reach back at most compression-window bytes.
+ *
+ * Output is pulled with read() in pieces of any size, e.g. straight into the
+ * +HTTPDATA DOWNLOAD window. The output for a given input is deterministic,
+ * so compressed_size() can run a counting pass before the real one.
+ */
+class SIMCOM_SIM800_Deflate {
+public:
+    SIMCOM_SIM800_Deflate();
+
+    /** Start compressing len bytes of data. The buffer must stay valid until finished(). */
+    void begin(const void *data, size_t len);
+
+    /** Produce up to len bytes of gzip output.
+     *
+     *  @return bytes written, 0 once the stream is finished
+     */
+    ssize_t read(uint8_t *buf, size_t len);
+
+    bool finished() const;
+
+    /** Size of the gzip stream for data, computed without storing it.
+     *  Leaves the compressor ready to stream the same data with read().
+     */
+    size_t compressed_size(const void *data, size_t len);
+
+private:
+    enum deflate_stage
+    {
+        STAGE_HEADER,
+        STAGE_BLOCK,
+        STAGE_TRAILER,
+        STAGE_DONE
+    };
+
+    void put_bits(uint32_t value, int count);
+    void put_huffman(uint32_t code, int count);
+    void put_symbol(int symbol);
+    void put_match(size_t length, size_t distance);
+    void encode_next();
+    static uint32_t hash(const uint8_t *p);
+    static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t len);
+
+    const uint8_t *_in;
+    size_t         _len;
+    size_t         _pos;
+    int            _stage;
+    int            _frame_pos;      // Header or trailer byte being emitted
+    uint64_t       _bits;           // Pending output, LSB first
+    int            _bitcount;
+    uint32_t       _crc;
+    uint32_t       _head[1 << DEFLATE_HASH_BITS];  // Last position + 1 per hash, 0 = empty
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_DEFLATE_H_
@@ -1,133 +1,483 @@
 #include "SIMCOM_SIM800_HTTP.h"
+#include "SIMCOM_SIM800_ATBatch.h"
+#include "SIMCOM_SIM800_Deflate.h"
+#include "SIMCOM_SIM800_Parser.h"
+#include "SIMCOM_SIM800_Sleep.h"
+#include "SIMCOM_SIM800_Stats.h"
+#include "SIMCOM_SIM800_Timing.h"
 #include "mbed_debug.h"
 #include "rtos/ThisThread.h"
+#include "platform/ScopedLock.h"
 #include <ctype.h>
 #include <stdio.h>
+#include <string.h>
 
 using namespace mbed;
+using namespace std::chrono;
 using namespace std::chrono_literals;
 
-SIMCOM_SIM800_HTTP::SIMCOM_SIM800_HTTP(ATHandler &at): _at(at)
-{
+static const char *const http_param_tags[] = {
+    "CID", "URL", "UA", "PROIP", "PROPORT", "TIMEOUT", "REDIR", "USERDATA", "BREAK", "BREAKEND"
+};
 
+SIMCOM_SIM800_HTTP::SIMCOM_SIM800_HTTP(ATHandler &at): _use_ssl(false), _at(at), _keep_session(false),
+    _session_open(false), _cid(0), _deflate(nullptr),
+    _user_data_long(false), _gzip_body(false), _encoding_header(false), _compress_min(HTTP_COMPRESS_MIN_SIZE)
+{
+    _user_data[0] = '\0';
+    memset(&_session_stats, 0, sizeof(_session_stats));
+    memset(&_compress_stats, 0, sizeof(_compress_stats));
+    invalidate_parameter_cache();
+    _at.set_urc_handler("+HTTPACTION:", mbed::Callback<void()>(this, &SIMCOM_SIM800_HTTP::urc_httpaction));
 }
 SIMCOM_SIM800_HTTP::~SIMCOM_SIM800_HTTP()
 {
+    _at.set_urc_handler("+HTTPACTION:", nullptr);
+    delete _deflate;
+}
+
+void SIMCOM_SIM800_HTTP::attach_action_cb(http_action_cb_t cb)
+{
+    _action_cb = cb;
+}
+
+void SIMCOM_SIM800_HTTP::invalidate_parameter_cache()
+{
+    _request_mutex.lock();
+    memset(_param_cache, 0, sizeof(_param_cache));
+    _request_mutex.unlock();
+}
+
+int SIMCOM_SIM800_HTTP::param_index(const char *paramTag)
+{
+    for (int i = 0; i < (int)(sizeof(http_param_tags) / sizeof(http_param_tags[0])); i++) {
+        if (strcmp(paramTag, http_param_tags[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint32_t SIMCOM_SIM800_HTTP::param_hash(const char *value)
+{
+    uint32_t hash = 2166136261u;
+    while (*value) {
+        hash = (hash ^ (uint8_t)*value++) * 16777619u;
+    }
+    return hash;
+}
+
+bool SIMCOM_SIM800_HTTP::param_cached(int index, uint32_t value, size_t len)
+{
+    return index >= 0 && _param_cache[index].valid &&
+           _param_cache[index].value == value && _param_cache[index].len == len;
+}
+
+void SIMCOM_SIM800_HTTP::param_update(int index, nsapi_error_t err, uint32_t value, size_t len)
+{
+    if (err != NSAPI_ERROR_OK) {
+        // Modem state unknown after an ERROR
+        memset(_param_cache, 0, sizeof(_param_cache));
+        return;
+    }
+    if (index >= 0) {
+        _param_cache[index].valid = true;
+        _param_cache[index].value = value;
+        _param_cache[index].len = len;
+    }
+}
 
+void SIMCOM_SIM800_HTTP::read_line(char *buf, size_t size)
+{
+    // No delimiter, read_string() runs to the end of the information line
+    _at.set_delimiter('\0');
+    if(_at.read_string(buf, size) < 0)
+    {
+        buf[0] = '\0';
+    }
+    _at.set_default_delimiter();
+}
+
+void SIMCOM_SIM800_HTTP::urc_httpaction()
+{
+    //+HTTPACTION: <Method>,<StatusCode>,<DataLen>
+    char line[SIM800_RESPONSE_LINE_LENGTH];
+    read_line(line, sizeof(line));
+    if(!SIMCOM_SIM800_Parser::parse_http_action(line, strlen(line), &_action_result.method,
+                                                &_action_result.status_code, &_action_result.data_len))
+    {
+        // Still complete the action, a zero status code fails the request
+        tr_debug("Malformed +HTTPACTION:%s", line);
+        _action_result.method = -1;
+        _action_result.status_code = 0;
+        _action_result.data_len = 0;
+    }
+    _action_flags.set(HTTP_ACTION_DONE_FLAG);
+    if (_action_cb) {
+        _action_cb(&_action_result);
+    }
 }
 
 device_err_t SIMCOM_SIM800_HTTP::init(unsigned int timeout)
 {
+    device_err_t err = {DeviceErrorTypeNoError, 0};
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    if(_keep_session && _session_open)
+    {
+        _session_stats.hits++;
+        return err;
+    }
     tr_info("Init HTTP");
-    device_err_t err;
+    _session_stats.misses++;
+    // Fresh HTTP session starts from modem defaults
+    invalidate_parameter_cache();
     if(timeout != 0){
         _at.set_at_timeout(timeout);
     }
 
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_HTTPINIT);
     for (int retry = 1; retry <= 3; retry++) 
     {
+       if(retry > 1)
+       {
+           SIM800_STATS_RETRY(stats);
+       }
        _at.at_cmd_discard("+HTTPINIT","", "");
         err = _at.get_last_device_error();
         if(err.errType == DeviceErrorTypeNoError)
         {
-           return err;
+           break;
         }
-        tr_debug("Wait 100ms to try again Initialize http");
-        rtos::ThisThread::sleep_for(100ms); // let modem have time to get ready
+        tr_debug("Wait to try again Initialize http");
+        rtos::ThisThread::sleep_for(SIMCOM_SIM800_Timing::backoff(retry + 1, 100ms, 800ms)); // let modem have time to get ready
     }
 
     if(timeout != 0){
     _at.restore_at_timeout();
     }
-    tr_info("Modem CME ERROR - %d", err.errCode);
+    if(err.errType != DeviceErrorTypeNoError)
+    {
+        tr_info("Modem CME ERROR - %d", err.errCode);
+    }
+    _session_open = (err.errType == DeviceErrorTypeNoError);
+    SIM800_STATS_RESULT(stats, !_session_open);
+    if(_session_open && _cid)
+    {
+        // A fresh session defaults to CID 1
+        parameter("CID", _cid, timeout);
+    }
     return err;
 }
 
 device_err_t SIMCOM_SIM800_HTTP::terminate(unsigned int timeout)
+{
+    device_err_t err = {DeviceErrorTypeNoError, 0};
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    if(_keep_session)
+    {
+        return err;
+    }
+    return close_session(timeout);
+}
+
+void SIMCOM_SIM800_HTTP::set_session_keep(bool onoff)
+{
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    _keep_session = onoff;
+}
+
+void SIMCOM_SIM800_HTTP::bind_cid(int cid)
+{
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    _cid = cid;
+}
+
+int SIMCOM_SIM800_HTTP::get_cid() const
+{
+    return _cid;
+}
+
+bool SIMCOM_SIM800_HTTP::is_session_open() const
+{
+    return _session_open;
+}
+
+void SIMCOM_SIM800_HTTP::get_session_stats(http_session_stats_t *stats) const
+{
+    *stats = _session_stats;
+}
+
+bool SIMCOM_SIM800_HTTP::recover_session()
+{
+    // SIM800 answers ERROR to +HTTPPARA once the session is gone, e.g. after
+    // a modem reset or bearer loss
+    if(!_keep_session || !_session_open)
+    {
+        return false;
+    }
+    tr_info("HTTP session lost, re-initialising");
+    _session_stats.lost++;
+    _session_open = false;
+    return init(0).errType == DeviceErrorTypeNoError;
+}
+
+device_err_t SIMCOM_SIM800_HTTP::close_session(unsigned int timeout)
 {
     device_err_t err;
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    _session_open = false;
+    invalidate_parameter_cache();
     if(timeout){
         _at.set_at_timeout(timeout);
     }
 
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_HTTPINIT);
     for (int retry = 1; retry <= 3; retry++) 
     {
+        if(retry > 1)
+        {
+            SIM800_STATS_RETRY(stats);
+        }
         _at.at_cmd_discard("+HTTPTERM", "");
         err = _at.get_last_device_error();
         if(err.errType == DeviceErrorTypeNoError)
         {
-           return err;
+           break;
         }
-        tr_debug("Wait 1000ms to try terminate http again");
-        rtos::ThisThread::sleep_for(1000ms); // let modem have time to get ready
+        tr_debug("Wait to try terminate http again");
+        rtos::ThisThread::sleep_for(SIMCOM_SIM800_Timing::backoff(retry + 1, 1000ms, 4000ms)); // let modem have time to get ready
     }
 
     if(timeout){
     _at.restore_at_timeout();
     }
-    tr_info("Modem CME ERROR - %d", err.errCode);
+    if(err.errType != DeviceErrorTypeNoError)
+    {
+        tr_info("Modem CME ERROR - %d", err.errCode);
+    }
+    SIM800_STATS_RESULT(stats, err.errType != DeviceErrorTypeNoError);
     return err;
 }
 
 nsapi_error_t SIMCOM_SIM800_HTTP::set_http_parameters(http_parameters_t *param,  unsigned int timeout)
 {
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    SIMCOM_SIM800_ATBatch batch(_at);
+    http_param_batch_t pending = {};
+
     if(param->user_data != nullptr)
     {
-        parameter("USERDATA", param->user_data, timeout);
+        keep_user_data(param->user_data);
+        batch_parameter(batch, pending, "USERDATA", param->user_data, timeout);
     }
     if(param->proxy_addr != nullptr)
     {
-        parameter("PROPORT", param->proxy_port, timeout);
-        parameter("PROIP", param->proxy_addr, timeout);
+        batch_parameter(batch, pending, "PROPORT", param->proxy_port, timeout);
+        batch_parameter(batch, pending, "PROIP", param->proxy_addr, timeout);
     }
     if(param->timeout != 0)
     {
-        parameter("TIMEOUT", param->timeout, timeout);
-        parameter("BREAK", param->brk, timeout);
-        parameter("BREAKEND", param->brk_end, timeout);
+        batch_parameter(batch, pending, "TIMEOUT", param->timeout, timeout);
+        batch_parameter(batch, pending, "BREAK", param->brk, timeout);
+        batch_parameter(batch, pending, "BREAKEND", param->brk_end, timeout);
     }
     if(param->user_agent != nullptr)
     {
-        parameter("UA", param->user_agent, timeout);
+        batch_parameter(batch, pending, "UA", param->user_agent, timeout);
+    }
+    batch_parameter(batch, pending, "CID", _cid ? _cid : param->cid, timeout);
+    batch_parameter(batch, pending, "REDIR", param->redir == true ? 1:0, timeout);
+    if(!param_cached(PARAM_SSL, param->ssl ? 1 : 0, 0))
+    {
+        if(batch.add("+HTTPSSL", "=", "%d", param->ssl ? 1 : 0) == NSAPI_ERROR_OK)
+        {
+            pending.index[pending.count] = PARAM_SSL;
+            pending.value[pending.count] = param->ssl ? 1 : 0;
+            pending.len[pending.count++] = 0;
+        }
+        else
+        {
+            set_ssl(param->ssl);
+        }
+    }
+
+    if(timeout != 0){
+        _at.set_at_timeout(timeout);
+    }
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_HTTPPARA);
+    nsapi_error_t err = batch.execute();
+    SIM800_STATS_RESULT(stats, err != NSAPI_ERROR_OK);
+    if(timeout != 0){
+        _at.restore_at_timeout();
+    }
+    for(int i = 0; i < pending.count; i++)
+    {
+        param_update(pending.index[i], err, pending.value[i], pending.len[i]);
+    }
+    if(param->user_data != nullptr && param_cached(PARAM_USERDATA, param_hash(param->user_data), strlen(param->user_data)))
+    {
+        _encoding_header = false;
     }
-    parameter("CID", param->cid, timeout);
-    parameter("REDIR", param->redir == true ? 1:0, timeout);
-    set_ssl(param->ssl);
 
-return NSAPI_ERROR_OK;
+return err;
+}
+
+void SIMCOM_SIM800_HTTP::batch_parameter(SIMCOM_SIM800_ATBatch &batch, http_param_batch_t &pending,
+                                         const char* paramTag, const char* paramValue, unsigned int timeout)
+{
+    const int index = param_index(paramTag);
+    const uint32_t hash = param_hash(paramValue);
+    const size_t len = strlen(paramValue);
+    if(param_cached(index, hash, len))
+    {
+        return;
+    }
+    if(index < 0 || batch.add("+HTTPPARA","=", "%s%s", paramTag, paramValue) != NSAPI_ERROR_OK)
+    {
+        parameter(paramTag, paramValue, timeout);
+        return;
+    }
+    pending.index[pending.count] = index;
+    pending.value[pending.count] = hash;
+    pending.len[pending.count++] = len;
+}
+
+void SIMCOM_SIM800_HTTP::batch_parameter(SIMCOM_SIM800_ATBatch &batch, http_param_batch_t &pending,
+                                         const char* paramTag, int paramValue, unsigned int timeout)
+{
+    const int index = param_index(paramTag);
+    if(param_cached(index, (uint32_t)paramValue, 0))
+    {
+        return;
+    }
+    if(index < 0 || batch.add("+HTTPPARA","=", "%s%d", paramTag, paramValue) != NSAPI_ERROR_OK)
+    {
+        parameter(paramTag, paramValue, timeout);
+        return;
+    }
+    pending.index[pending.count] = index;
+    pending.value[pending.count] = (uint32_t)paramValue;
+    pending.len[pending.count++] = 0;
 }
 
 nsapi_error_t SIMCOM_SIM800_HTTP::parameter(const char* paramTag, const char* paramValue, unsigned int timeout)
 {
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    if(param_index(paramTag) != PARAM_USERDATA)
+    {
+        return send_parameter(paramTag, paramValue, timeout);
+    }
+    keep_user_data(paramValue);
+    nsapi_error_t err = send_parameter(paramTag, paramValue, timeout);
+    if(err == NSAPI_ERROR_OK)
+    {
+        _encoding_header = false;
+    }
+    return err;
+}
+
+void SIMCOM_SIM800_HTTP::keep_user_data(const char *user_data)
+{
+    size_t len = strlen(user_data);
+    _user_data_long = (len > HTTP_USERDATA_LENGTH);
+    if(!_user_data_long)
+    {
+        memcpy(_user_data, user_data, len + 1);
+    }
+}
+
+nsapi_error_t SIMCOM_SIM800_HTTP::apply_user_data(bool gzip)
+{
+    // SIM800 separates USERDATA headers with the literal characters \r\n
+    static const char encoding[] = "Content-Encoding: gzip";
+    char value[HTTP_USERDATA_LENGTH + sizeof("\\r\\n") + sizeof(encoding)];
+    if(gzip)
+    {
+        snprintf(value, sizeof(value), "%s%s%s", _user_data, _user_data[0] ? "\\r\\n" : "", encoding);
+    }
+    else
+    {
+        strcpy(value, _user_data);
+    }
+    nsapi_error_t err = send_parameter("USERDATA", value, 0);
+    if(err == NSAPI_ERROR_OK)
+    {
+        _encoding_header = gzip;
+    }
+    return err;
+}
+
+nsapi_error_t SIMCOM_SIM800_HTTP::send_parameter(const char* paramTag, const char* paramValue, unsigned int timeout)
+{
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    const int index = param_index(paramTag);
+    const uint32_t hash = param_hash(paramValue);
+    const size_t len = strlen(paramValue);
+    if(param_cached(index, hash, len))
+    {
+        return NSAPI_ERROR_OK;
+    }
+
     if(timeout != 0){
         _at.set_at_timeout(timeout);
     }
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_HTTPPARA);
     for (int retry = 1; retry <= 3; retry++) 
     {
+        if(retry > 1)
+        {
+            SIM800_STATS_RETRY(stats);
+        }
         _at.clear_error();
         _at.at_cmd_discard("+HTTPPARA","=", "%s%s", paramTag, paramValue);
         if (_at.get_last_error() == NSAPI_ERROR_OK) 
         {
             break;
         }
-        tr_debug("Wait 100ms to try again set %s parameter", paramTag);
-        rtos::ThisThread::sleep_for(100ms); // let modem have time to get ready
+        tr_debug("Wait to try again set %s parameter", paramTag);
+        rtos::ThisThread::sleep_for(SIMCOM_SIM800_Timing::backoff(retry + 1, 100ms, 800ms)); // let modem have time to get ready
     }
+    if(_at.get_last_error() != NSAPI_ERROR_OK && recover_session())
+    {
+        SIM800_STATS_RETRY(stats);
+        _at.clear_error();
+        _at.at_cmd_discard("+HTTPPARA","=", "%s%s", paramTag, paramValue);
+    }
+    SIM800_STATS_TX(stats, len);
+    SIM800_STATS_RESULT(stats, _at.get_last_error() != NSAPI_ERROR_OK);
 
     if(timeout != 0){
     _at.restore_at_timeout();
     }
 
+    param_update(index, _at.get_last_error(), hash, len);
     return _at.get_last_error();
 }
 
 nsapi_error_t SIMCOM_SIM800_HTTP::parameter(const char* paramTag, int paramValue, unsigned int timeout)
 {
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    const int index = param_index(paramTag);
+    if(index == PARAM_CID && _cid)
+    {
+        // Bound by the bearer, the application cannot move the session
+        paramValue = _cid;
+    }
+    if(param_cached(index, (uint32_t)paramValue, 0))
+    {
+        return NSAPI_ERROR_OK;
+    }
+
     if(timeout != 0){
         _at.set_at_timeout(timeout);
     }
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_HTTPPARA);
     for (int retry = 1; retry <= 3; retry++) 
     {
+        if(retry > 1)
+        {
+            SIM800_STATS_RETRY(stats);
+        }
         _at.clear_error();
         _at.at_cmd_discard("+HTTPPARA","=", "%s%d", paramTag, paramValue);
         if (_at.get_last_error() == NSAPI_ERROR_OK) 
@@ -135,15 +485,23 @@ nsapi_error_t SIMCOM_SIM800_HTTP::parameter(const char* paramTag, int paramValue
             break;
         }
         #if MBED_CONF_MBED_TRACE_ENABLE
-        tr_debug("Wait 100ms to try again set %s parameter", paramTag);
+        tr_debug("Wait to try again set %s parameter", paramTag);
         #endif
-        rtos::ThisThread::sleep_for(100ms); // let modem have time to get ready
+        rtos::ThisThread::sleep_for(SIMCOM_SIM800_Timing::backoff(retry + 1, 100ms, 800ms)); // let modem have time to get ready
+    }
+    if(_at.get_last_error() != NSAPI_ERROR_OK && recover_session())
+    {
+        SIM800_STATS_RETRY(stats);
+        _at.clear_error();
+        _at.at_cmd_discard("+HTTPPARA","=", "%s%d", paramTag, paramValue);
     }
+    SIM800_STATS_RESULT(stats, _at.get_last_error() != NSAPI_ERROR_OK);
 
     if(timeout != 0){
     _at.restore_at_timeout();
     }
 
+    param_update(index, _at.get_last_error(), (uint32_t)paramValue, 0);
     return _at.get_last_error();
 }
 
@@ -154,6 +512,7 @@ bool SIMCOM_SIM800_HTTP::request(http_request_t *req, unsigned int waittime)
     tr_info("\nServer address - %s\n", req->url);
 #endif
     http_action_result_t result;
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
 
     if(parameter("URL", req->url, waittime) != NSAPI_ERROR_OK)
     {
@@ -182,8 +541,28 @@ bool SIMCOM_SIM800_HTTP::request(http_request_t *req, unsigned int waittime)
         }
         if(req->get_respose)
         {
-            http_read(req->income, 0, result.data_len);
-            tr_info("DBG-> Response %s", req->income);
+            size_t len = result.data_len;
+            if(req->income_size != nullptr)
+            {
+                if(*req->income_size == 0)
+                {
+                    return false;
+                }
+                if(len > *req->income_size - 1)
+                {
+                    len = *req->income_size - 1;
+                }
+            }
+            if(http_read(req->income, 0, len, &len).errType != DeviceErrorType::DeviceErrorTypeNoError)
+            {
+                return false;
+            }
+            req->income[len] = '\0';
+            if(req->income_size != nullptr)
+            {
+                *req->income_size = len;
+            }
+            tr_debug("Response %s", req->income);
         }
     break;
 
@@ -208,6 +587,7 @@ bool SIMCOM_SIM800_HTTP::request(http_method_t type, const char *URL, const char
     tr_info("\nServer address - %s\n", URL);
 #endif
     http_action_result_t result;
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
 
     if(parameter("URL", URL, 0) != NSAPI_ERROR_OK)
     {
@@ -253,6 +633,130 @@ bool SIMCOM_SIM800_HTTP::request(http_method_t type, const char *URL, const char
     return true;
 }
 
+bool SIMCOM_SIM800_HTTP::request(http_method_t type, const char *URL, const char *data_out, int len_out,
+                                 http_sink_t sink, unsigned int waittime)
+{
+    http_action_result_t result;
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+
+    if(type != http_method::POST)
+    {
+        return false;
+    }
+    if(parameter("URL", URL, waittime) != NSAPI_ERROR_OK)
+    {
+        return false;
+    }
+    set_ssl(_use_ssl);
+    if(http_write(data_out, len_out).errType != DeviceErrorType::DeviceErrorTypeNoError)
+    {
+        return false;
+    }
+    if(!post_action(&result))
+    {
+        return false;
+    }
+    return read_stream(sink, result.data_len).errType == DeviceErrorType::DeviceErrorTypeNoError;
+}
+
+bool SIMCOM_SIM800_HTTP::request(http_method_t type, const char *URL, const http_iovec_t *iov, size_t iovcnt,
+                                 unsigned int waittime)
+{
+    http_action_result_t result;
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+
+    if(type != http_method::POST)
+    {
+        return false;
+    }
+    if(parameter("URL", URL, waittime) != NSAPI_ERROR_OK)
+    {
+        return false;
+    }
+    set_ssl(_use_ssl);
+    if(http_write(iov, iovcnt).errType != DeviceErrorType::DeviceErrorTypeNoError)
+    {
+        return false;
+    }
+    return post_action(&result);
+}
+
+bool SIMCOM_SIM800_HTTP::request(http_method_t type, const char *URL, http_source_t source, size_t len_out,
+                                 unsigned int waittime)
+{
+    http_action_result_t result;
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+
+    if(type != http_method::POST)
+    {
+        return false;
+    }
+    if(parameter("URL", URL, waittime) != NSAPI_ERROR_OK)
+    {
+        return false;
+    }
+    set_ssl(_use_ssl);
+    if(http_write(source, len_out).errType != DeviceErrorType::DeviceErrorTypeNoError)
+    {
+        return false;
+    }
+    return post_action(&result);
+}
+
+bool SIMCOM_SIM800_HTTP::post_action(http_action_result_t *result)
+{
+    if(http_action(http_method::POST, result).errType != DeviceErrorType::DeviceErrorTypeNoError)
+    {
+        return false;
+    }
+    if(result->status_code != 200)
+    {
+        #if MBED_CONF_MBED_TRACE_ENABLE
+        tr_info("HTTP status code - %d", result->status_code);
+        #endif
+        return false;
+    }
+    return true;
+}
+
+device_err_t SIMCOM_SIM800_HTTP::read_stream(http_sink_t sink, size_t data_len)
+{
+    device_err_t err = {DeviceErrorTypeNoError, 0};
+    size_t offset = 0;
+
+    while(offset < data_len)
+    {
+        size_t window = data_len - offset;
+        size_t len = 0;
+        if(window > sizeof(_chunk))
+        {
+            window = sizeof(_chunk);
+        }
+        err = http_read((char *)_chunk, offset, window, &len);
+        if(err.errType != DeviceErrorTypeNoError)
+        {
+            return err;
+        }
+        if(len == 0)
+        {
+            // Modem holds less than +HTTPACTION reported, the sink has a truncated body
+            tr_info("HTTP body short at %u of %u", (unsigned int)offset, (unsigned int)data_len);
+            err.errType = DeviceErrorTypeError;
+            err.errCode = NSAPI_ERROR_DEVICE_ERROR;
+            return err;
+        }
+        if(sink(_chunk, len) != NSAPI_ERROR_OK)
+        {
+            tr_debug("HTTP sink aborted at %u", (unsigned int)offset);
+            err.errType = DeviceErrorTypeError;
+            err.errCode = NSAPI_ERROR_NO_MEMORY;
+            return err;
+        }
+        offset += len;
+    }
+    return err;
+}
+
 bool SIMCOM_SIM800_HTTP::response(char* data_in, int len_in, unsigned int waittime)
 {
     return true;
@@ -261,34 +765,31 @@ bool SIMCOM_SIM800_HTTP::response(char* data_in, int len_in, unsigned int waitti
 device_err_t SIMCOM_SIM800_HTTP::get_status(http_status_t *stat)
 {
     device_err_t err;
-    char buf[8] = {0};
-    _at.lock();
+    char line[SIM800_RESPONSE_LINE_LENGTH] = {0};
+    SIM800_AT_LOCK(_at);
     _at.flush();
     _at.clear_error();
 
     _at.cmd_start("AT+HTTPSTATUS?");
     _at.cmd_stop();
     _at.resp_start("+HTTPSTATUS:");
-    _at.read_string(buf, 16);
-    stat->status = _at.read_int();
-    stat->finish = _at.read_int();
-    stat->remain = _at.read_int();
+    read_line(line, sizeof(line));
     _at.resp_stop();
 
      err = _at.get_last_device_error();
     _at.unlock();
 
-    if(strcmp(buf, "GET") == 0)
-    {
-        stat->mode = 0;
-    }
-    else if(strcmp(buf, "POST") == 0)
+    if(err.errType != DeviceErrorTypeNoError)
     {
-        stat->mode = 1;
+        return err;
     }
-    else if(strcmp(buf, "HEAD") == 0)
+    if(!SIMCOM_SIM800_Parser::parse_http_status(line, strlen(line), &stat->mode, &stat->status,
+                                                &stat->finish, &stat->remain))
     {
-        stat->mode = 2;
+        tr_debug("Malformed +HTTPSTATUS:%s", line);
+        err.errType = DeviceErrorTypeError;
+        err.errCode = NSAPI_ERROR_DEVICE_ERROR;
+        return err;
     }
 #if MBED_CONF_MBED_TRACE_ENABLE
     tr_info("+HTTPSTATUS: - %d,%d,%d,%d,", stat->mode, stat->status, stat->finish, stat->remain);
@@ -298,9 +799,20 @@ device_err_t SIMCOM_SIM800_HTTP::get_status(http_status_t *stat)
 
 nsapi_error_t SIMCOM_SIM800_HTTP::set_ssl(bool onoff)
 {
-    _at.lock();
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    if(param_cached(PARAM_SSL, onoff ? 1 : 0, 0))
+    {
+        return NSAPI_ERROR_OK;
+    }
+
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_HTTPPARA);
+    SIM800_AT_LOCK(_at);
     for (int retry = 1; retry <= 3; retry++) 
     {
+        if(retry > 1)
+        {
+            SIM800_STATS_RETRY(stats);
+        }
         _at.clear_error();
         _at.flush();
         _at.at_cmd_discard("+HTTPSSL", "=", "%d", onoff == true ? 1:0);
@@ -308,93 +820,266 @@ nsapi_error_t SIMCOM_SIM800_HTTP::set_ssl(bool onoff)
         {
             break;
         }
-        tr_debug("Wait 100ms to try again set HTTPSSL parameter");
-        rtos::ThisThread::sleep_for(100ms); // let modem have time to get ready
+        tr_debug("Wait to try again set HTTPSSL parameter");
+        rtos::ThisThread::sleep_for(SIMCOM_SIM800_Timing::backoff(retry + 1, 100ms, 800ms)); // let modem have time to get ready
     }
+    SIM800_STATS_RESULT(stats, _at.get_last_error() != NSAPI_ERROR_OK);
+    param_update(PARAM_SSL, _at.get_last_error(), onoff ? 1 : 0, 0);
     return _at.unlock_return_error();
 }
 
+void SIMCOM_SIM800_HTTP::set_compression(bool onoff, size_t min_size)
+{
+    ScopedLock<rtos::Mutex> lock(_request_mutex);
+    if(onoff && !_deflate)
+    {
+        _deflate = new SIMCOM_SIM800_Deflate();
+    }
+    else if(!onoff && _deflate)
+    {
+        delete _deflate;
+        _deflate = nullptr;
+    }
+    _compress_min = min_size;
+}
+
+void SIMCOM_SIM800_HTTP::get_compression_stats(http_compression_stats_t *stats) const
+{
+    *stats = _compress_stats;
+}
+
 device_err_t SIMCOM_SIM800_HTTP::http_write(const char *data_out, int len_out)
+{
+    if(_deflate && len_out > 0 && (size_t)len_out >= _compress_min)
+    {
+        bool sent = false;
+        device_err_t err = http_write_compressed(data_out, len_out, &sent);
+        if(sent)
+        {
+            return err;
+        }
+    }
+
+    http_iovec_t iov = {data_out, (size_t)len_out};
+    return http_write(&iov, 1);
+}
+
+device_err_t SIMCOM_SIM800_HTTP::http_write_compressed(const char *data_out, size_t len_out, bool *sent)
+{
+    device_err_t err = {DeviceErrorTypeNoError, 0};
+
+    // Counting pass: HTTPDATA needs the length before the first byte
+    size_t zlen = _user_data_long ? len_out : _deflate->compressed_size(data_out, len_out);
+    if(zlen >= len_out)
+    {
+        _compress_stats.skipped++;
+        return err;
+    }
+    *sent = true;
+
+    // Second pass compresses into the staging buffer while DOWNLOAD is open
+    err = http_write(http_source_t(_deflate, &SIMCOM_SIM800_Deflate::read), zlen);
+    if(err.errType == DeviceErrorTypeNoError)
+    {
+        // http_action() adds the encoding header
+        _gzip_body = true;
+        _compress_stats.compressed++;
+        _compress_stats.bytes_in += len_out;
+        _compress_stats.bytes_out += zlen;
+        tr_debug("HTTP body gzip %u -> %u bytes", (unsigned int)len_out, (unsigned int)zlen);
+    }
+    return err;
+}
+
+device_err_t SIMCOM_SIM800_HTTP::http_write(const http_iovec_t *iov, size_t iovcnt)
 {
     device_err_t err;
-    _at.lock();
+    size_t len_out = 0;
+    for(size_t i = 0; i < iovcnt; i++)
+    {
+        len_out += iov[i].len;
+    }
+
+    // Body transfer at the current UART rate is not modem response time
+    milliseconds transfer = SIMCOM_SIM800_Timing::transfer_time(len_out);
+
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_HTTPDATA);
+    SIM800_AT_LOCK(_at);
     _at.flush();
     _at.clear_error();
-    _at.set_at_timeout(10000ms);
-    _at.cmd_start_stop("+HTTPDATA","=", "%d%d", len_out, 2000);
+    auto start = SIMCOM_SIM800_Timing::start();
+    _at.set_at_timeout(SIMCOM_SIM800_Timing::timeout(SIM800_CMD_HTTPDATA, transfer + SIM800_TIMING_MIN_TIMEOUT, HTTP_DATA_TIMEOUT));
+    _at.cmd_start_stop("+HTTPDATA","=", "%d%d", len_out, HTTP_DATA_INPUT_TIME);
     _at.resp_start("DOWNLOAD", true);
-    _at.write_bytes((uint8_t *)data_out, len_out);
-    _at.restore_at_timeout();
+    for(size_t i = 0; i < iovcnt; i++)
+    {
+        _at.write_bytes((const uint8_t *)iov[i].base, iov[i].len);
+    }
     _at.resp_stop();
+    SIMCOM_SIM800_Timing::complete(SIM800_CMD_HTTPDATA, _at, start, transfer);
+    _at.restore_at_timeout();
     err = _at.get_last_device_error();
     _at.unlock();
+    SIM800_STATS_TX(stats, len_out);
+    SIM800_STATS_RESULT(stats, err.errType != DeviceErrorTypeNoError);
+    if(err.errType != DeviceErrorTypeNoError)
+    {
+        invalidate_parameter_cache();
+    }
     return err;
 }
 
-device_err_t SIMCOM_SIM800_HTTP::http_action(http_method_t type, http_action_result_t *res_act)
+device_err_t SIMCOM_SIM800_HTTP::http_write(http_source_t source, size_t len_out)
 {
     device_err_t err;
-    char buf[32];
+    size_t remaining = len_out;
 
-    sprintf(buf, "AT+HTTPACTION=%d", (int)type);
-    _at.lock();
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_HTTPDATA);
+    SIM800_AT_LOCK(_at);
     _at.flush();
     _at.clear_error();
-    _at.set_at_timeout(5s);
-    _at.cmd_start(buf);
-    _at.cmd_stop();
-    _at.resp_start();
+    _at.set_at_timeout(milliseconds(HTTP_STREAM_INPUT_TIME + 1000));
+    _at.cmd_start_stop("+HTTPDATA","=", "%d%d", len_out, HTTP_STREAM_INPUT_TIME);
+    _at.resp_start("DOWNLOAD", true);
+    while(remaining && _at.get_last_error() == NSAPI_ERROR_OK)
+    {
+        size_t want = remaining < sizeof(_chunk) ? remaining : sizeof(_chunk);
+        ssize_t got = source(_chunk, want);
+        if(got <= 0)
+        {
+            // Modem closes the window once the input time expires
+            break;
+        }
+        if((size_t)got > want)
+        {
+            got = want;
+        }
+        _at.write_bytes(_chunk, got);
+        remaining -= got;
+    }
     _at.resp_stop();
-    _at.set_delimiter(0);
-    _at.resp_start("+HTTPACTION:");
-    int counter = 200;
-    tr_info("DBG-> wait +HTTPACTION:");
-    while(!_at.info_resp() && counter--)
+    _at.restore_at_timeout();
+    err = _at.get_last_device_error();
+    _at.unlock();
+    if(err.errType != DeviceErrorTypeNoError)
     {
-        rtos::ThisThread::sleep_for(100ms);
-        //_at.cmd_stop();
+        invalidate_parameter_cache();
     }
-    tr_info("DBG-> counter: %d", counter);
-    _at.read_string(buf, sizeof(buf));
+
+    if(remaining && err.errType == DeviceErrorTypeNoError)
+    {
+        tr_debug("HTTP source ended %u bytes short", (unsigned int)remaining);
+        err.errType = DeviceErrorTypeError;
+        err.errCode = NSAPI_ERROR_PARAMETER;
+    }
+    SIM800_STATS_TX(stats, len_out - remaining);
+    SIM800_STATS_RESULT(stats, err.errType != DeviceErrorTypeNoError);
+    return err;
+}
+
+device_err_t SIMCOM_SIM800_HTTP::http_action(http_method_t type, http_action_result_t *res_act)
+{
+    device_err_t err = {DeviceErrorTypeNoError, 0};
+
+    // Encoding header for this request only, the application value otherwise
+    bool gzip = _gzip_body;
+    _gzip_body = false;
+    if((gzip || _encoding_header) && apply_user_data(gzip) != NSAPI_ERROR_OK)
+    {
+        err.errType = DeviceErrorTypeError;
+        err.errCode = NSAPI_ERROR_DEVICE_ERROR;
+        return err;
+    }
+
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_HTTPACTION);
+    SIM800_AT_LOCK(_at);
+    _at.flush();
+    _at.clear_error();
+    _action_flags.clear(HTTP_ACTION_DONE_FLAG);
+    auto start = SIMCOM_SIM800_Timing::start();
+    _at.set_at_timeout(SIMCOM_SIM800_Timing::timeout(SIM800_CMD_HTTPACTION, SIM800_TIMING_MIN_TIMEOUT, HTTP_ACTION_ACK_TIMEOUT));
+    _at.cmd_start_stop("+HTTPACTION", "=", "%d", (int)type);
+    _at.resp_start();
     _at.resp_stop();
-    _at.set_default_delimiter();
+    SIMCOM_SIM800_Timing::complete(SIM800_CMD_HTTPACTION, _at, start);
     err = _at.get_last_device_error();
     _at.restore_at_timeout();
     _at.unlock();
-    //tr_info("DBG-> +HTTPACTION: %s", buf);
-    sscanf(buf, "%d,%d,%d", &(res_act->method), &(res_act->status_code), &(res_act->data_len));
+    if(err.errType != DeviceErrorTypeNoError)
+    {
+        SIM800_STATS_RESULT(stats, true);
+        invalidate_parameter_cache();
+        return err;
+    }
+
+    // Server round-trip runs with the AT lock released, other AT users may proceed.
+    // URCs are normally dispatched from the device event queue, process_oob() covers
+    // applications that drive the modem without dispatching that queue.
+    auto deadline = rtos::Kernel::Clock::now() + HTTP_ACTION_TIMEOUT;
+    uint32_t flags = 0;
+    tr_debug("wait +HTTPACTION:");
+    SIMCOM_SIM800_Sleep::hold(); // The URC arrives while the AT lock is free
+    while(rtos::Kernel::Clock::now() < deadline)
+    {
+        flags = _action_flags.wait_any_for(HTTP_ACTION_DONE_FLAG, 1s);
+        if(!(flags & osFlagsError) && (flags & HTTP_ACTION_DONE_FLAG))
+        {
+            break;
+        }
+        _at.process_oob();
+        flags = _action_flags.wait_any_for(HTTP_ACTION_DONE_FLAG, 0s);
+        if(!(flags & osFlagsError) && (flags & HTTP_ACTION_DONE_FLAG))
+        {
+            break;
+        }
+    }
+    SIMCOM_SIM800_Sleep::release();
+
+    if((flags & osFlagsError) || !(flags & HTTP_ACTION_DONE_FLAG))
+    {
+        tr_info("+HTTPACTION: timeout");
+        SIM800_STATS_RESULT(stats, true);
+        err.errType = DeviceErrorTypeError;
+        err.errCode = NSAPI_ERROR_TIMEOUT;
+        return err;
+    }
+    *res_act = _action_result;
     return err;
 
 }
 
-device_err_t SIMCOM_SIM800_HTTP::http_read(char *data_in, unsigned int start_address, size_t data_len)
+device_err_t SIMCOM_SIM800_HTTP::http_read(char *data_in, unsigned int start_address, size_t data_len, size_t *read_len)
 {
+    //+HTTPREAD: <data_len>\r\n<data>
     device_err_t err;
-    _at.lock();
+    int len = 0;
+    SIM800_STATS_SCOPE(stats, SIM800_CMD_HTTPREAD);
+    SIM800_AT_LOCK(_at);
     _at.flush();
     _at.clear_error();
-    _at.cmd_start("AT+HTTPREAD");
-    _at.cmd_stop();
+    _at.cmd_start_stop("+HTTPREAD", "=", "%d%d", start_address, data_len);
     _at.resp_start("+HTTPREAD:");
-     while(!_at.info_resp())
+    len = _at.read_int();
+    if(len > 0)
     {
-        rtos::ThisThread::sleep_for(100ms);
-        //_at.cmd_stop();
+        // do not read more than buffer size
+        if((size_t)len > data_len)
+        {
+            len = data_len;
+        }
+        _at.read_bytes((uint8_t *)data_in, len);
     }
-
-    //*data_len = (size_t)_at.read_int();
-    _at.skip_param();
-    _at.read_bytes((uint8_t *)data_in, data_len);
-    //_at.read_string(data_in, data_len);
     _at.resp_stop();
-    data_in[data_len+1] = '\0';
     err = _at.get_last_device_error();
     _at.unlock();
-    
+
+    *read_len = (len > 0 && err.errType == DeviceErrorTypeNoError) ? len : 0;
+    SIM800_STATS_RX(stats, *read_len);
+    SIM800_STATS_RESULT(stats, err.errType != DeviceErrorTypeNoError);
     if(err.errType != DeviceErrorTypeNoError)
     {
         tr_debug("Modem CME ERROR - %d", err.errCode);
         return err;
     }
     return err;
-}
\ No newline at end of file
+}
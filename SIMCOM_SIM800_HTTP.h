@@ -22,15 +22,33 @@
 #include "AT_CellularDevice.h"
 #include "CellularLog.h"
 #include "ATHandler.h"
+#include "rtos/EventFlags.h"
+#include "rtos/Mutex.h"
  #include <stdint.h>
 
 #define GET_RESPONSE_FLAG        1<<0
 #define HEAD_INTO_RESPONSE_FLAG  1<<1
 
+#define HTTP_ACTION_DONE_FLAG    1<<0
+#define HTTP_ACTION_TIMEOUT      20s
+#define HTTP_ACTION_ACK_TIMEOUT  5s     // Worst case for OK to +HTTPACTION, the result comes by URC
+#define HTTP_DATA_TIMEOUT        10000ms // Worst case for DOWNLOAD and OK around a contiguous body
+#define HTTP_DATA_INPUT_TIME     2000   // ms, DOWNLOAD window for a contiguous body
+#define HTTP_STREAM_INPUT_TIME   10000  // ms, DOWNLOAD window while a producer fills the body
+#define HTTP_COMPRESS_MIN_SIZE   64     // Bodies below this are sent verbatim
+#define HTTP_USERDATA_LENGTH     256    // Application USERDATA kept to add the encoding header
+
+#ifndef MBED_CONF_SIMCOM_SIM800_HTTP_CHUNK_SIZE
+#define MBED_CONF_SIMCOM_SIM800_HTTP_CHUNK_SIZE 256
+#endif
+
 #define SIM_HTTP_METHOD SIMCOM_SIM800_HTTP::http_method
 
 namespace mbed {
 
+class SIMCOM_SIM800_ATBatch;
+class SIMCOM_SIM800_Deflate;
+
 /**
  * Class SIMCOM_SIM800_HTTP
  *
@@ -70,7 +88,7 @@ public:
     const char*         outgo;       //
     size_t        outgo_size;  //
     char*         income;      //
-    size_t*       income_size; //
+    size_t*       income_size; // In: income capacity incl. terminator, out: bytes received. May be nullptr
     bool          get_respose; //
     }http_request_t;
 
@@ -92,29 +110,134 @@ public:
 
     } http_status_t;
 
+    typedef struct http_compression_stats
+    {
+    unsigned int  compressed;  // Bodies sent gzip encoded
+    unsigned int  skipped;     // Bodies sent verbatim, too small or incompressible
+    size_t        bytes_in;    // Body bytes before compression, compressed bodies only
+    size_t        bytes_out;   // Body bytes sent for those bodies
+    }http_compression_stats_t;
+
+    typedef struct http_session_stats
+    {
+    unsigned int  hits;        // init() served by a kept session
+    unsigned int  misses;      // init() that sent AT+HTTPINIT
+    unsigned int  lost;        // Kept sessions found invalid by +HTTPPARA ERROR and re-initialised
+    }http_session_stats_t;
+
+    typedef Callback<void(const http_action_result_t *)> http_action_cb_t;
+
+    /** Consumer of a streamed response body. Returns NSAPI_ERROR_OK to continue.
+     */
+    typedef Callback<nsapi_error_t(const uint8_t *data, size_t len)> http_sink_t;
+
+    /** Producer of a streamed request body. Fills up to len bytes of buf and
+     *  returns the number of bytes written, 0 or negative aborts the upload.
+     */
+    typedef Callback<ssize_t(uint8_t *buf, size_t len)> http_source_t;
+
+    typedef struct http_iovec
+    {
+    const void*   base;        // Buffer, sent without copying
+    size_t        len;         //
+    }http_iovec_t;
+
     SIMCOM_SIM800_HTTP(ATHandler &at);
     virtual ~SIMCOM_SIM800_HTTP();
 
 public:
 
-    /** Initialize HTTP Service.
+    /** Initialize HTTP Service. With session keeping, an open session is reused.
      *
      *  @return error with error code and type
      */
     virtual device_err_t init(unsigned int timeout);
-    /** Terminate HTTP Service.
+    /** Terminate HTTP Service. With session keeping, the session stays open
+     *  until close_session().
      *
      *  @return error with error code and type (No ERROR, AT ERROR, AT ERROR CMS, AT ERROR CME)
      */
     virtual device_err_t terminate(unsigned int timeout);
+
+    /** Keep the HTTP session initialised across init()/terminate() pairs.
+     *  An invalidated session (+HTTPPARA ERROR) is re-initialised on demand.
+     */
+    void set_session_keep(bool onoff);
+
+    /** Bind the HTTP service to a bearer profile. Each init() sends the CID,
+     *  and it overrides http_parameters_t::cid and parameter("CID", ...).
+     *
+     *  @param cid SAPBR profile 1-3, 0 to unbind
+     */
+    void bind_cid(int cid);
+    int get_cid() const;
+
+    /** Send AT+HTTPTERM for a kept session. */
+    device_err_t close_session(unsigned int timeout);
+
+    bool is_session_open() const;
+    void get_session_stats(http_session_stats_t *stats) const;
     virtual nsapi_error_t parameter(const char* paramTag, const char* paramValue, unsigned int timeout);
     virtual nsapi_error_t parameter(const char* paramTag, int paramValue, unsigned int timeout);
     virtual nsapi_error_t set_http_parameters(http_parameters_t *param, unsigned int timeout);
     virtual bool request(http_method_t type, const char *URL, const char *data_out, int len_out, unsigned int waittime);
     virtual bool request(http_request_t *req, unsigned int waittime);
+
+    /** POST and stream the response body into a sink in http-chunk-size windows.
+     *
+     *  @return true if the server answered 200 and the whole body was consumed
+     */
+    virtual bool request(http_method_t type, const char *URL, const char *data_out, int len_out,
+                         http_sink_t sink, unsigned int waittime);
+
+    /** POST a body scattered over several buffers, each written straight into
+     *  the DOWNLOAD window.
+     *
+     *  @return true if the server answered 200
+     */
+    virtual bool request(http_method_t type, const char *URL, const http_iovec_t *iov, size_t iovcnt,
+                         unsigned int waittime);
+
+    /** POST len_out bytes pulled from a producer through an http-chunk-size staging buffer.
+     *
+     *  @return true if the server answered 200
+     */
+    virtual bool request(http_method_t type, const char *URL, http_source_t source, size_t len_out,
+                         unsigned int waittime);
+
+    /** Fetch data_len bytes of the last response with ranged AT+HTTPREAD=<start>,<size>
+     *  and hand each window to the sink. Only an http-chunk-size buffer is used.
+     *
+     *  @return error with error code and type, NSAPI_ERROR_DEVICE_ERROR if the modem
+     *          holds less than data_len bytes (the sink got a truncated body)
+     */
+    virtual device_err_t read_stream(http_sink_t sink, size_t data_len);
     virtual bool response(char* data_in, int len_in, unsigned int waittime);
     virtual device_err_t get_status(http_status_t *stat);
     virtual nsapi_error_t set_ssl(bool onoff=false);
+
+    /** Gzip contiguous POST bodies of at least min_size bytes on their way into
+     *  the DOWNLOAD window. A "Content-Encoding: gzip" header is appended to the
+     *  application's USERDATA for that request only, the application value is
+     *  sent again before the next action. Bodies that would not shrink, or whose
+     *  USERDATA exceeds HTTP_USERDATA_LENGTH, are sent verbatim.
+     */
+    void set_compression(bool onoff, size_t min_size = HTTP_COMPRESS_MIN_SIZE);
+
+    /** Compression counters; bytes_out / bytes_in is the achieved ratio. */
+    void get_compression_stats(http_compression_stats_t *stats) const;
+
+    /** Forget the HTTPPARA/HTTPSSL values the modem is assumed to hold.
+     *  Call after a modem reset so the next request re-sends every parameter.
+     */
+    void invalidate_parameter_cache();
+
+    /** Register a callback for +HTTPACTION completion.
+     *  Called from the ATHandler URC context, so it must not issue AT commands.
+     *
+     *  @param cb callback, nullptr to remove
+     */
+    void attach_action_cb(http_action_cb_t cb);
     
     /** Show the HTTP Header Information in HTTPREAD.
      *
@@ -123,11 +246,88 @@ public:
     //virtual nsapi_error_t showhead(bool show);
 
 private:
+    enum http_param_index
+    {
+        PARAM_CID = 0,
+        PARAM_URL,
+        PARAM_UA,
+        PARAM_PROIP,
+        PARAM_PROPORT,
+        PARAM_TIMEOUT,
+        PARAM_REDIR,
+        PARAM_USERDATA,
+        PARAM_BREAK,
+        PARAM_BREAKEND,
+        PARAM_SSL,      // AT+HTTPSSL, not an HTTPPARA tag
+        PARAM_COUNT
+    };
+
+    typedef struct http_param_cache
+    {
+    bool          valid;       // Modem acknowledged value
+    uint32_t      value;       // Integer value, or FNV-1a hash of a string value
+    size_t        len;         // String length, 0 for integers
+    }http_param_cache_t;
+
+    typedef struct http_param_batch
+    {
+    int           count;
+    int           index[PARAM_COUNT];
+    uint32_t      value[PARAM_COUNT];
+    size_t        len[PARAM_COUNT];
+    }http_param_batch_t;
+
+    static int param_index(const char *paramTag);
+    static uint32_t param_hash(const char *value);
+    bool param_cached(int index, uint32_t value, size_t len);
+    void param_update(int index, nsapi_error_t err, uint32_t value, size_t len);
+    void batch_parameter(SIMCOM_SIM800_ATBatch &batch, http_param_batch_t &pending,
+                         const char* paramTag, const char* paramValue, unsigned int timeout);
+    void batch_parameter(SIMCOM_SIM800_ATBatch &batch, http_param_batch_t &pending,
+                         const char* paramTag, int paramValue, unsigned int timeout);
+
+    bool recover_session();
+    bool post_action(http_action_result_t *result);
     device_err_t http_write(const char *data_out, int len_out);
-    device_err_t http_read(char *data_in, unsigned int start_address, size_t data_len);
+    device_err_t http_write_compressed(const char *data_out, size_t len_out, bool *sent);
+    device_err_t http_write(const http_iovec_t *iov, size_t iovcnt);
+    device_err_t http_write(http_source_t source, size_t len_out);
+    device_err_t http_read(char *data_in, unsigned int start_address, size_t data_len, size_t *read_len);
     device_err_t http_action(http_method_t type, http_action_result_t *res_act);
+    nsapi_error_t send_parameter(const char* paramTag, const char* paramValue, unsigned int timeout);
+    void keep_user_data(const char *user_data);
+    nsapi_error_t apply_user_data(bool gzip);
+    void urc_httpaction();
+    void read_line(char *buf, size_t size);
     bool _use_ssl;
     ATHandler &_at;
+
+    // +HTTPACTION completes by URC while the AT lock is released
+    rtos::EventFlags     _action_flags;
+    http_action_result_t _action_result;
+    http_action_cb_t     _action_cb;
+    rtos::Mutex          _request_mutex;
+
+    uint8_t              _chunk[MBED_CONF_SIMCOM_SIM800_HTTP_CHUNK_SIZE];
+
+    // Session keeping, see set_session_keep()
+    bool                 _keep_session;
+    bool                 _session_open;
+    http_session_stats_t _session_stats;
+
+    int                  _cid;           // Bound bearer profile, 0 if unbound
+
+    // Optional gzip stage, allocated by set_compression(true)
+    SIMCOM_SIM800_Deflate *_deflate;
+    char                 _user_data[HTTP_USERDATA_LENGTH + 1];  // Application USERDATA
+    bool                 _user_data_long; // Application USERDATA did not fit, no encoding header
+    bool                 _gzip_body;      // Body in the modem is gzip encoded
+    bool                 _encoding_header; // Modem USERDATA may carry the encoding header
+    size_t               _compress_min;
+    http_compression_stats_t _compress_stats;
+
+    // Shadow of the last values acknowledged by the modem, only changes are sent
+    http_param_cache_t   _param_cache[PARAM_COUNT];
 };
 
 } // namespace mbed
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_HTTPAggregator.h"
+#include "CellularLog.h"
+#include "platform/ScopedLock.h"
+#include <string.h>
+
+using namespace mbed;
+using namespace std::chrono;
+
+SIMCOM_SIM800_HTTPAggregator::SIMCOM_SIM800_HTTPAggregator(SIMCOM_SIM800_HTTP &http, const aggregator_config_t &config,
+                                                           events::EventQueue *queue):
+    _http(http),
+    _config(config),
+    _queue(queue),
+    _len(0),
+    _count(0),
+    _age_id(0),
+    _flush_queued(false)
+{
+    if (_config.flush_size == 0 || _config.flush_size > sizeof(_buf)) {
+        _config.flush_size = sizeof(_buf);
+    }
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+SIMCOM_SIM800_HTTPAggregator::~SIMCOM_SIM800_HTTPAggregator()
+{
+    if (_queue && _age_id) {
+        _queue->cancel(_age_id);
+    }
+}
+
+nsapi_error_t SIMCOM_SIM800_HTTPAggregator::append(const void *record, size_t len)
+{
+    size_t framed = len + (_config.framing == FRAMING_LENGTH_PREFIX ? 2 : 1);
+
+    if (_config.framing == FRAMING_LENGTH_PREFIX) {
+        if (len > 0xFFFF) {
+            return NSAPI_ERROR_PARAMETER;
+        }
+    } else if (memchr(record, '\n', len)) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+
+    bool flush_now = false;
+    {
+        ScopedLock<rtos::Mutex> lock(_mutex);
+        if (framed > sizeof(_buf) - _len) {
+            _stats.dropped++;
+            return NSAPI_ERROR_NO_MEMORY;
+        }
+
+        uint8_t *p = _buf + _len;
+        if (_config.framing == FRAMING_LENGTH_PREFIX) {
+            *p++ = len >> 8;
+            *p++ = len & 0xFF;
+            memcpy(p, record, len);
+        } else {
+            memcpy(p, record, len);
+            p[len] = '\n';
+        }
+        if (_len == 0) {
+            _oldest = rtos::Kernel::Clock::now();
+            arm_age_timer();
+        }
+        _len += framed;
+        _count++;
+        _stats.records++;
+
+        if (_len >= _config.flush_size) {
+            if (!_queue) {
+                flush_now = true;
+            } else if (!_flush_queued && _queue->call(this, &SIMCOM_SIM800_HTTPAggregator::flush_event)) {
+                _flush_queued = true;
+            }
+        }
+    }
+
+    if (flush_now) {
+        // The record is buffered, a failed POST is retried by the next flush
+        flush();
+    }
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t SIMCOM_SIM800_HTTPAggregator::flush()
+{
+    ScopedLock<rtos::Mutex> flush_lock(_flush_mutex);
+
+    _mutex.lock();
+    size_t len = _len;
+    unsigned int count = _count;
+    if (_queue && _age_id) {
+        _queue->cancel(_age_id);
+        _age_id = 0;
+    }
+    _mutex.unlock();
+
+    if (len == 0) {
+        return NSAPI_ERROR_OK;
+    }
+
+    // Only [0, len) is read, append() writes behind it
+    bool ok = _http.request(SIMCOM_SIM800_HTTP::POST, _config.url, (const char *)_buf, len, _config.waittime);
+
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    if (ok) {
+        memmove(_buf, _buf + len, _len - len);
+        _len -= len;
+        _count -= count;
+        _stats.posts++;
+        _stats.records_sent += count;
+        _stats.bytes_sent += len;
+        if (_len) {
+            // Records appended during the POST, their exact age is not tracked
+            _oldest = rtos::Kernel::Clock::now();
+        }
+    } else {
+        tr_debug("Aggregated POST of %d records failed, kept for retry", count);
+        _stats.failures++;
+    }
+    if (_len) {
+        arm_age_timer();
+    }
+    return ok ? NSAPI_ERROR_OK : NSAPI_ERROR_DEVICE_ERROR;
+}
+
+void SIMCOM_SIM800_HTTPAggregator::poll()
+{
+    _mutex.lock();
+    bool due = _len && _config.max_age.count() > 0 && rtos::Kernel::Clock::now() - _oldest >= _config.max_age;
+    _mutex.unlock();
+    if (due) {
+        flush();
+    }
+}
+
+size_t SIMCOM_SIM800_HTTPAggregator::pending() const
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    return _len;
+}
+
+void SIMCOM_SIM800_HTTPAggregator::get_stats(aggregator_stats_t *stats)
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    *stats = _stats;
+}
+
+void SIMCOM_SIM800_HTTPAggregator::flush_event()
+{
+    _mutex.lock();
+    _flush_queued = false;
+    _mutex.unlock();
+    flush();
+}
+
+void SIMCOM_SIM800_HTTPAggregator::age_event()
+{
+    _mutex.lock();
+    _age_id = 0;
+    _mutex.unlock();
+    flush();
+}
+
+void SIMCOM_SIM800_HTTPAggregator::arm_age_timer()
+{
+    // Called with _mutex held. After a failed POST this also paces the retry.
+    if (!_queue || _age_id || _config.max_age.count() <= 0) {
+        return;
+    }
+    _age_id = _queue->call_in(_config.max_age, this, &SIMCOM_SIM800_HTTPAggregator::age_event);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_HTTPAGGREGATOR_H_
+#define SIMCOM_SIM800_HTTPAGGREGATOR_H_
+
+#include "SIMCOM_SIM800_HTTP.h"
+#include "events/EventQueue.h"
+#include "rtos/Kernel.h"
+#include "rtos/Mutex.h"
+#include <chrono>
+#include <stdint.h>
+
+#ifndef MBED_CONF_SIMCOM_SIM800_HTTP_AGGREGATOR_SIZE
+#define MBED_CONF_SIMCOM_SIM800_HTTP_AGGREGATOR_SIZE 1024
+#endif
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_HTTPAggregator
+ *
+ * Coalesces small records into one POST body. Records are framed into a
+ * buffer of http-aggregator-size bytes and sent when flush_size bytes are
+ * pending, when the oldest record is max_age old, or on flush().
+ * A failed POST keeps the batch at the front of the buffer, so the next
+ * flush retries it with the newer records behind it, in order.
+ *
+ * With an event queue, size and age flushes run from that queue. Without
+ * one, size flushes run in append() and age flushes in poll().
+ * A flush is a blocking POST that can take as long as the +HTTPACTION wait, so
+ * the queue must not be the device event queue: that queue dispatches the
+ * +HTTPACTION: URC the POST is waiting for. Use a queue with its own thread.
+ */
+class SIMCOM_SIM800_HTTPAggregator {
+public:
+    enum framing
+    {
+        FRAMING_NEWLINE       = 0, // record '\n', records must not contain '\n'
+        FRAMING_LENGTH_PREFIX = 1  // 16 bit big endian length, then record
+    };
+
+    typedef struct aggregator_config
+    {
+    const char*               url;        //
+    int                       framing;    // framing
+    size_t                    flush_size; // Pending bytes that trigger a flush, 0 = buffer size
+    std::chrono::milliseconds max_age;    // Age of the oldest record that triggers a flush, 0 = none
+    unsigned int              waittime;   // Passed to SIMCOM_SIM800_HTTP::request()
+    }aggregator_config_t;
+
+    typedef struct aggregator_stats
+    {
+    unsigned int  records;       // Accepted by append()
+    unsigned int  records_sent;  //
+    unsigned int  dropped;       // Rejected by append(), buffer full
+    unsigned int  posts;         // Successful POSTs
+    unsigned int  failures;      // Failed POSTs, the batch was kept
+    size_t        bytes_sent;    // Framed body bytes of successful POSTs
+    }aggregator_stats_t;
+
+    /** @param queue  runs size and age flushes, must not be CellularDevice::get_queue() */
+    SIMCOM_SIM800_HTTPAggregator(SIMCOM_SIM800_HTTP &http, const aggregator_config_t &config,
+                                 events::EventQueue *queue = nullptr);
+    virtual ~SIMCOM_SIM800_HTTPAggregator();
+
+    /** Frame and buffer a record.
+     *
+     *  @return NSAPI_ERROR_OK, NSAPI_ERROR_NO_MEMORY if the buffer is full,
+     *          NSAPI_ERROR_PARAMETER if the record cannot be framed
+     */
+    nsapi_error_t append(const void *record, size_t len);
+
+    /** POST everything pending now.
+     *
+     *  @return NSAPI_ERROR_OK if nothing is pending or the POST succeeded
+     */
+    nsapi_error_t flush();
+
+    /** Flush if the oldest record reached max_age. For use without an event queue. */
+    void poll();
+
+    /** Framed bytes waiting to be sent. */
+    size_t pending() const;
+
+    void get_stats(aggregator_stats_t *stats);
+
+private:
+    void flush_event();
+    void age_event();
+    void arm_age_timer();
+
+    SIMCOM_SIM800_HTTP   &_http;
+    aggregator_config_t   _config;
+    events::EventQueue   *_queue;
+
+    uint8_t               _buf[MBED_CONF_SIMCOM_SIM800_HTTP_AGGREGATOR_SIZE];
+    size_t                _len;
+    unsigned int          _count;
+    rtos::Kernel::Clock::time_point _oldest;
+    int                   _age_id;
+    bool                  _flush_queued;
+    aggregator_stats_t    _stats;
+
+    // _mutex guards the buffer state, _flush_mutex keeps one POST in flight.
+    // Appends land behind the batch being sent, so they do not wait for the POST.
+    mutable rtos::Mutex   _mutex;
+    rtos::Mutex           _flush_mutex;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_HTTPAGGREGATOR_H_
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_HTTPScheduler.h"
+#include "CellularLog.h"
+#include "platform/ScopedLock.h"
+#include <string.h>
+
+using namespace mbed;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+SIMCOM_SIM800_HTTPScheduler::SIMCOM_SIM800_HTTPScheduler(SIMCOM_SIM800_Bearer &bearer, SIMCOM_SIM800_SignalMonitor *signal,
+                                                         SIMCOM_SIM800_HTTP::http_parameters_t *params):
+    _bearer(bearer),
+    _http(nullptr),
+    _signal(signal),
+    _params(params),
+    _seq(0),
+    _next_id(1),
+    _thread(osPriorityNormal, MBED_CONF_SIMCOM_SIM800_HTTP_SCHEDULER_STACK_SIZE, nullptr, "sim800_http")
+{
+    for (int i = 0; i < MBED_CONF_SIMCOM_SIM800_HTTP_QUEUE_SIZE; i++) {
+        _slots[i].used = false;
+    }
+    memset(&_stats, 0, sizeof(_stats));
+    _thread.start(mbed::Callback<void()>(this, &SIMCOM_SIM800_HTTPScheduler::worker));
+}
+
+SIMCOM_SIM800_HTTPScheduler::~SIMCOM_SIM800_HTTPScheduler()
+{
+    // Lets the running request finish, queued jobs are dropped
+    _flags.set(HTTP_SCHEDULER_STOP_FLAG);
+    _thread.join();
+    if (_http) {
+        // Keeps the session instead with http-session-idle-timeout set
+        _http->terminate(0);
+        _bearer.close_http();
+    }
+}
+
+SIMCOM_SIM800_HTTP *SIMCOM_SIM800_HTTPScheduler::get_http()
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    return _http;
+}
+
+SIMCOM_SIM800_HTTP *SIMCOM_SIM800_HTTPScheduler::acquire_http(nsapi_error_t *err)
+{
+    // Worker thread only, so init() never races a job
+    _mutex.lock();
+    SIMCOM_SIM800_HTTP *http = _http;
+    _mutex.unlock();
+    if (http) {
+        return http;
+    }
+    http = _bearer.open_http();
+    if (!http) {
+        *err = NSAPI_ERROR_NO_CONNECTION;
+        return nullptr;
+    }
+    // HTTPINIT and the bound CID, then the caller's parameters on the fresh session
+    if (http->init(0).errType != DeviceErrorTypeNoError ||
+            (_params && http->set_http_parameters(_params, 0) != NSAPI_ERROR_OK)) {
+        tr_warning("HTTP scheduler: service init failed");
+        http->terminate(0);
+        _bearer.close_http();
+        *err = NSAPI_ERROR_DEVICE_ERROR;
+        return nullptr;
+    }
+    _mutex.lock();
+    _http = http;
+    _mutex.unlock();
+    return http;
+}
+
+int SIMCOM_SIM800_HTTPScheduler::submit(const http_job_t &job)
+{
+    if (job.request.url == nullptr) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    http_slot_t *slot = nullptr;
+    for (int i = 0; i < MBED_CONF_SIMCOM_SIM800_HTTP_QUEUE_SIZE; i++) {
+        if (!_slots[i].used) {
+            slot = &_slots[i];
+            break;
+        }
+    }
+    if (!slot) {
+        _stats.rejected++;
+        return NSAPI_ERROR_NO_MEMORY;
+    }
+
+    slot->used = true;
+    slot->id = _next_id;
+    slot->seq = _seq++;
+    slot->submitted = rtos::Kernel::Clock::now();
+    slot->has_deadline = job.deadline.count() > 0;
+    slot->deadline = slot->submitted + job.deadline;
+    slot->defer_until = slot->submitted + job.max_defer;
+    slot->deferred = false;
+    slot->job = job;
+    // Ids stay positive so they never collide with an nsapi error
+    _next_id = (_next_id == INT32_MAX) ? 1 : _next_id + 1;
+
+    _stats.submitted++;
+    _stats.depth++;
+    if (_stats.depth > _stats.max_depth) {
+        _stats.max_depth = _stats.depth;
+    }
+    _flags.set(HTTP_SCHEDULER_WAKE_FLAG);
+    return slot->id;
+}
+
+bool SIMCOM_SIM800_HTTPScheduler::cancel(int id)
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    for (int i = 0; i < MBED_CONF_SIMCOM_SIM800_HTTP_QUEUE_SIZE; i++) {
+        // Running jobs are no longer in the pool
+        if (_slots[i].used && _slots[i].id == id) {
+            _slots[i].used = false;
+            _stats.depth--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SIMCOM_SIM800_HTTPScheduler::get_stats(http_scheduler_stats_t *stats)
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    *stats = _stats;
+}
+
+void SIMCOM_SIM800_HTTPScheduler::reset_stats()
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    unsigned int depth = _stats.depth;
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.depth = depth;
+    _stats.max_depth = depth;
+}
+
+bool SIMCOM_SIM800_HTTPScheduler::deferrable(const http_slot_t *slot)
+{
+    return slot->job.priority == PRIORITY_BULK && slot->job.max_defer.count() > 0;
+}
+
+bool SIMCOM_SIM800_HTTPScheduler::link_good()
+{
+    if (!_signal) {
+        return true;
+    }
+    bool waiting = false;
+    _mutex.lock();
+    for (int i = 0; i < MBED_CONF_SIMCOM_SIM800_HTTP_QUEUE_SIZE && !waiting; i++) {
+        waiting = _slots[i].used && deferrable(&_slots[i]);
+    }
+    _mutex.unlock();
+    // Only ask the modem when a job could be held
+    return waiting ? _signal->is_good() : true;
+}
+
+SIMCOM_SIM800_HTTPScheduler::http_slot_t *SIMCOM_SIM800_HTTPScheduler::pick(bool good, bool *expired, milliseconds *hold)
+{
+    rtos::Kernel::Clock::time_point now = rtos::Kernel::Clock::now();
+    http_slot_t *best = nullptr;
+
+    *expired = false;
+    *hold = 0ms;
+    for (int i = 0; i < MBED_CONF_SIMCOM_SIM800_HTTP_QUEUE_SIZE; i++) {
+        http_slot_t *slot = &_slots[i];
+        if (!slot->used) {
+            continue;
+        }
+        if (slot->has_deadline && now > slot->deadline) {
+            // Report expired jobs first, they cost no modem time
+            *expired = true;
+            return slot;
+        }
+        if (!good && deferrable(slot) && now < slot->defer_until) {
+            if (!slot->deferred) {
+                slot->deferred = true;
+                _stats.deferred++;
+                _stats.deferred_bytes += slot->job.request.outgo_size;
+            }
+            // Look again when the signal sample expires or the hold ends
+            milliseconds left = duration_cast<milliseconds>(slot->defer_until - now) + 1ms;
+            milliseconds poll(MBED_CONF_SIMCOM_SIM800_SIGNAL_CACHE_TTL);
+            if (left < poll) {
+                poll = left;
+            }
+            if (*hold == 0ms || poll < *hold) {
+                *hold = poll;
+            }
+            continue;
+        }
+        if (!best) {
+            best = slot;
+        } else if (slot->job.priority != best->job.priority) {
+            if (slot->job.priority > best->job.priority) {
+                best = slot;
+            }
+        } else if (slot->has_deadline != best->has_deadline) {
+            if (slot->has_deadline) {
+                best = slot;
+            }
+        } else if (slot->has_deadline && slot->deadline != best->deadline) {
+            if (slot->deadline < best->deadline) {
+                best = slot;
+            }
+        } else if ((int32_t)(slot->seq - best->seq) < 0) {
+            best = slot;
+        }
+    }
+    return best;
+}
+
+void SIMCOM_SIM800_HTTPScheduler::complete(http_slot_t *slot, nsapi_error_t err, milliseconds wait, milliseconds run)
+{
+    http_job_result_t result;
+    result.id = slot->id;
+    result.err = err;
+    result.wait = wait;
+    result.run = run;
+    result.request = &slot->job.request;
+    if (slot->job.cb) {
+        slot->job.cb(&result);
+    }
+}
+
+void SIMCOM_SIM800_HTTPScheduler::worker()
+{
+    http_slot_t current;
+    milliseconds hold = 0ms;
+    nsapi_error_t http_err;
+
+    // Service ready before the first job; jobs retry if this fails
+    acquire_http(&http_err);
+
+    while (true) {
+        // Held jobs need a timed wake-up, nothing else will submit them
+        uint32_t flags = hold > 0ms ?
+                         _flags.wait_any_for(HTTP_SCHEDULER_WAKE_FLAG | HTTP_SCHEDULER_STOP_FLAG, hold) :
+                         _flags.wait_any(HTTP_SCHEDULER_WAKE_FLAG | HTTP_SCHEDULER_STOP_FLAG);
+        if (!(flags & osFlagsError) && (flags & HTTP_SCHEDULER_STOP_FLAG)) {
+            return;
+        }
+
+        while (true) {
+            bool expired;
+            bool good = link_good();
+            _mutex.lock();
+            http_slot_t *slot = pick(good, &expired, &hold);
+            if (slot) {
+                // Free the slot before running so submit() can refill the pool
+                current = *slot;
+                slot->used = false;
+                _stats.depth--;
+            }
+            _mutex.unlock();
+            if (!slot) {
+                break;
+            }
+
+            rtos::Kernel::Clock::time_point start = rtos::Kernel::Clock::now();
+            milliseconds wait = duration_cast<milliseconds>(start - current.submitted);
+            if (expired) {
+                tr_debug("HTTP job %d expired after %d ms", current.id, (int)wait.count());
+                _mutex.lock();
+                _stats.expired++;
+                _stats.completed++;
+                _stats.failed++;
+                _mutex.unlock();
+                complete(&current, NSAPI_ERROR_TIMEOUT, wait, 0ms);
+                continue;
+            }
+
+            nsapi_error_t http_err = NSAPI_ERROR_OK;
+            SIMCOM_SIM800_HTTP *http = acquire_http(&http_err);
+            if (!http) {
+                tr_debug("HTTP job %d: no HTTP service (%d)", current.id, http_err);
+                _mutex.lock();
+                _stats.completed++;
+                _stats.failed++;
+                _mutex.unlock();
+                complete(&current, http_err, wait, 0ms);
+                continue;
+            }
+
+            bool ok = http->request(&current.job.request, current.job.waittime);
+            milliseconds run = duration_cast<milliseconds>(rtos::Kernel::Clock::now() - start);
+
+            _mutex.lock();
+            _stats.completed++;
+            if (!ok) {
+                _stats.failed++;
+            }
+            _stats.total_wait_ms += wait.count();
+            if ((uint32_t)wait.count() > _stats.max_wait_ms) {
+                _stats.max_wait_ms = wait.count();
+            }
+            if (current.deferred && !good) {
+                _stats.forced++;
+            } else if (current.deferred && ok) {
+                _stats.deferred_ok++;
+            }
+            _mutex.unlock();
+            complete(&current, ok ? NSAPI_ERROR_OK : NSAPI_ERROR_DEVICE_ERROR, wait, run);
+
+            if (_flags.get() & HTTP_SCHEDULER_STOP_FLAG) {
+                return;
+            }
+        }
+    }
+}
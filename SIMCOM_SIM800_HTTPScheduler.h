@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_HTTPSCHEDULER_H_
+#define SIMCOM_SIM800_HTTPSCHEDULER_H_
+
+#include "SIMCOM_SIM800_Bearer.h"
+#include "SIMCOM_SIM800_HTTP.h"
+#include "SIMCOM_SIM800_SignalMonitor.h"
+#include "rtos/EventFlags.h"
+#include "rtos/Kernel.h"
+#include "rtos/Mutex.h"
+#include "rtos/Thread.h"
+#include <chrono>
+#include <stdint.h>
+
+#define HTTP_SCHEDULER_WAKE_FLAG 1<<0
+#define HTTP_SCHEDULER_STOP_FLAG 1<<1
+
+#ifndef MBED_CONF_SIMCOM_SIM800_HTTP_QUEUE_SIZE
+#define MBED_CONF_SIMCOM_SIM800_HTTP_QUEUE_SIZE 8
+#endif
+#ifndef MBED_CONF_SIMCOM_SIM800_HTTP_SCHEDULER_STACK_SIZE
+#define MBED_CONF_SIMCOM_SIM800_HTTP_SCHEDULER_STACK_SIZE 3072
+#endif
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_HTTPScheduler
+ *
+ * Owns the SIMCOM_SIM800_HTTP service of a bearer: the worker thread takes it
+ * with open_http() and runs init() before the first job, the destructor runs
+ * terminate() and close_http(). Every request runs on that worker thread. Any thread may submit() without blocking; jobs wait in
+ * a fixed pool of http-queue-size slots and run highest priority first, then
+ * earliest deadline, then in submission order. A running +HTTPACTION is never
+ * interrupted, so an urgent job waits at most for the request in progress.
+ *
+ * With a SIMCOM_SIM800_SignalMonitor, bulk jobs that set max_defer are held
+ * while the link is weak or unregistered, until it recovers or max_defer has
+ * passed. Normal and urgent jobs never wait for the signal.
+ *
+ * If another bearer holds the HTTP service, the worker asks again before
+ * every job. Until it has an initialised service, jobs complete with
+ * NSAPI_ERROR_NO_CONNECTION, or NSAPI_ERROR_DEVICE_ERROR if +HTTPINIT failed.
+ *
+ * Request buffers (URL, body, response) are borrowed and must stay valid until
+ * the completion callback, which is called from the worker thread.
+ */
+class SIMCOM_SIM800_HTTPScheduler {
+public:
+    enum http_priority
+    {
+        PRIORITY_BULK   = 0, // Telemetry, may wait
+        PRIORITY_NORMAL = 1, //
+        PRIORITY_URGENT = 2  // Alarms, jump ahead of queued jobs
+    };
+
+    typedef struct http_job_result
+    {
+    int                       id;       // Value returned by submit()
+    nsapi_error_t             err;      // NSAPI_ERROR_OK, NSAPI_ERROR_DEVICE_ERROR, NSAPI_ERROR_TIMEOUT when the deadline passed in the queue,
+                                        // NSAPI_ERROR_NO_CONNECTION while another bearer holds the HTTP service
+    std::chrono::milliseconds wait;     // Time spent queued
+    std::chrono::milliseconds run;      // Time spent on the modem
+    SIMCOM_SIM800_HTTP::http_request_t *request;
+    }http_job_result_t;
+
+    typedef Callback<void(const http_job_result_t *)> http_job_cb_t;
+
+    typedef struct http_job
+    {
+    SIMCOM_SIM800_HTTP::http_request_t request;  // Copied, buffers are borrowed
+    int                       priority;          // http_priority
+    std::chrono::milliseconds deadline;          // Latest start after submit, 0 = none
+    unsigned int              waittime;          // Passed to SIMCOM_SIM800_HTTP::request()
+    http_job_cb_t             cb;                // May be nullptr
+    std::chrono::milliseconds max_defer;         // PRIORITY_BULK only: longest hold while the signal is weak, 0 = never held
+    }http_job_t;
+
+    typedef struct http_scheduler_stats
+    {
+    unsigned int  depth;         // Jobs queued now, excluding the running one
+    unsigned int  max_depth;     //
+    unsigned int  submitted;     //
+    unsigned int  completed;     // Including failed
+    unsigned int  failed;        //
+    unsigned int  expired;       // Deadline passed before the job started
+    unsigned int  rejected;      // submit() found the pool full
+    uint32_t      total_wait_ms; // Sum of queue wait of started jobs
+    uint32_t      max_wait_ms;   //
+    unsigned int  deferred;      // Jobs held for a weak signal
+    uint32_t      deferred_bytes; // Request bodies of held jobs
+    unsigned int  forced;        // Held jobs sent on a weak signal once max_defer passed
+    unsigned int  deferred_ok;   // Held jobs that ran after the signal recovered and succeeded
+    }http_scheduler_stats_t;
+
+    /** @param params  sent with set_http_parameters() after each init(), borrowed, may be nullptr */
+    SIMCOM_SIM800_HTTPScheduler(SIMCOM_SIM800_Bearer &bearer, SIMCOM_SIM800_SignalMonitor *signal = nullptr,
+                                SIMCOM_SIM800_HTTP::http_parameters_t *params = nullptr);
+    virtual ~SIMCOM_SIM800_HTTPScheduler();
+
+    /** Queue a request.
+     *
+     *  @return job id (> 0), NSAPI_ERROR_NO_MEMORY if the pool is full,
+     *          NSAPI_ERROR_PARAMETER if the request has no URL
+     */
+    int submit(const http_job_t &job);
+
+    /** Remove a job that has not started. Its callback is not called.
+     *
+     *  @return true if the job was removed
+     */
+    bool cancel(int id);
+
+    void get_stats(http_scheduler_stats_t *stats);
+    void reset_stats();
+
+    /** HTTP service used by the worker, e.g. for its statistics.
+     *
+     *  @return nullptr until the worker has initialised it, or while another bearer holds it
+     */
+    SIMCOM_SIM800_HTTP *get_http();
+
+private:
+    typedef struct http_slot
+    {
+    bool                      used;
+    int                       id;
+    uint32_t                  seq;
+    rtos::Kernel::Clock::time_point submitted;
+    rtos::Kernel::Clock::time_point deadline;
+    bool                      has_deadline;
+    rtos::Kernel::Clock::time_point defer_until;
+    bool                      deferred;
+    http_job_t                job;
+    }http_slot_t;
+
+    void worker();
+    SIMCOM_SIM800_HTTP *acquire_http(nsapi_error_t *err);
+    static bool deferrable(const http_slot_t *slot);
+    bool link_good();
+    http_slot_t *pick(bool good, bool *expired, std::chrono::milliseconds *hold);
+    void complete(http_slot_t *slot, nsapi_error_t err, std::chrono::milliseconds wait,
+                  std::chrono::milliseconds run);
+
+    SIMCOM_SIM800_Bearer &_bearer;
+    SIMCOM_SIM800_HTTP   *_http;
+    SIMCOM_SIM800_SignalMonitor *_signal;
+    SIMCOM_SIM800_HTTP::http_parameters_t *_params;
+
+    http_slot_t           _slots[MBED_CONF_SIMCOM_SIM800_HTTP_QUEUE_SIZE];
+    uint32_t              _seq;
+    int                   _next_id;
+    http_scheduler_stats_t _stats;
+
+    rtos::Mutex           _mutex;
+    rtos::EventFlags      _flags;
+    rtos::Thread          _thread;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_HTTPSCHEDULER_H_
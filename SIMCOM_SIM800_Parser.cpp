@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_Parser.h"
+#include <limits.h>
+#include <string.h>
+
+using namespace mbed;
+
+static const char *const http_modes[] = {"GET", "POST", "HEAD"};
+
+SIMCOM_SIM800_Parser::SIMCOM_SIM800_Parser(const char *line, size_t len):
+    _pos(line), _end(line ? line + len : line), _ok(line != nullptr)
+{
+}
+
+void SIMCOM_SIM800_Parser::skip_spaces()
+{
+    while (_pos < _end && *_pos == ' ') {
+        _pos++;
+    }
+}
+
+bool SIMCOM_SIM800_Parser::fail()
+{
+    _ok = false;
+    return false;
+}
+
+void SIMCOM_SIM800_Parser::skip_prefix(const char *prefix)
+{
+    size_t len = strlen(prefix);
+    if (_ok && (size_t)(_end - _pos) >= len && memcmp(_pos, prefix, len) == 0) {
+        _pos += len;
+    }
+}
+
+bool SIMCOM_SIM800_Parser::read_int(int *value)
+{
+    if (!_ok) {
+        return false;
+    }
+    skip_spaces();
+    bool negative = false;
+    if (_pos < _end && (*_pos == '-' || *_pos == '+')) {
+        negative = (*_pos == '-');
+        _pos++;
+    }
+    if (_pos == _end || *_pos < '0' || *_pos > '9') {
+        return fail();
+    }
+    // Accumulate as negative, INT_MIN has no positive counterpart
+    int result = 0;
+    while (_pos < _end && *_pos >= '0' && *_pos <= '9') {
+        int digit = *_pos++ - '0';
+        if (result < (INT_MIN + digit) / 10) {
+            return fail();
+        }
+        result = result * 10 - digit;
+    }
+    if (!negative) {
+        if (result == INT_MIN) {
+            return fail();
+        }
+        result = -result;
+    }
+    *value = result;
+    return true;
+}
+
+bool SIMCOM_SIM800_Parser::read_range(int *value, int min, int max)
+{
+    int v;
+    if (!read_int(&v)) {
+        return false;
+    }
+    if (v < min || v > max) {
+        return fail();
+    }
+    *value = v;
+    return true;
+}
+
+bool SIMCOM_SIM800_Parser::read_string(char *buf, size_t size)
+{
+    if (!_ok || buf == nullptr || size == 0) {
+        return fail();
+    }
+    skip_spaces();
+    size_t len = 0;
+    if (_pos < _end && *_pos == '"') {
+        _pos++;
+        while (_pos < _end && *_pos != '"') {
+            if (len + 1 >= size) {
+                return fail();
+            }
+            buf[len++] = *_pos++;
+        }
+        if (_pos == _end) {
+            return fail(); // Unterminated
+        }
+        _pos++;
+    } else {
+        while (_pos < _end && *_pos != ',' && *_pos != '\r' && *_pos != '\n') {
+            if (len + 1 >= size) {
+                return fail();
+            }
+            buf[len++] = *_pos++;
+        }
+    }
+    buf[len] = '\0';
+    return true;
+}
+
+bool SIMCOM_SIM800_Parser::read_timezone(int *quarters)
+{
+    if (!_ok) {
+        return false;
+    }
+    if (_pos == _end || (*_pos != '+' && *_pos != '-')) {
+        return fail();
+    }
+    bool negative = (*_pos++ == '-');
+    int digits = 0;
+    int value = 0;
+    while (_pos < _end && *_pos >= '0' && *_pos <= '9') {
+        if (++digits > 2) {
+            return fail();
+        }
+        value = value * 10 + (*_pos++ - '0');
+    }
+    // UTC-12:00 to UTC+14:00
+    if (digits == 0 || value > (negative ? 48 : 56)) {
+        return fail();
+    }
+    *quarters = negative ? -value : value;
+    return true;
+}
+
+bool SIMCOM_SIM800_Parser::expect(char c)
+{
+    if (!_ok) {
+        return false;
+    }
+    skip_spaces();
+    if (_pos == _end || *_pos != c) {
+        return fail();
+    }
+    _pos++;
+    return true;
+}
+
+void SIMCOM_SIM800_Parser::optional(char c)
+{
+    if (_ok && _pos < _end && *_pos == c) {
+        _pos++;
+    }
+}
+
+bool SIMCOM_SIM800_Parser::done()
+{
+    while (_ok && _pos < _end && (*_pos == ' ' || *_pos == '\r' || *_pos == '\n')) {
+        _pos++;
+    }
+    if (_ok && _pos < _end && *_pos == '\0') {
+        _pos = _end; // Line given with its buffer size
+    }
+    return _ok && _pos == _end;
+}
+
+bool SIMCOM_SIM800_Parser::parse_clock(const char *line, size_t len, struct tm *t, int *tz_quarters)
+{
+    SIMCOM_SIM800_Parser p(line, len);
+    int year, month, day, hour, min, sec, tz;
+
+    p.skip_prefix("+CCLK:");
+    p.skip_spaces();
+    p.optional('"');
+    p.read_range(&year, 0, 99) && p.expect('/') &&
+        p.read_range(&month, 1, 12) && p.expect('/') &&
+        p.read_range(&day, 1, 31) && p.expect(',') &&
+        p.read_range(&hour, 0, 23) && p.expect(':') &&
+        p.read_range(&min, 0, 59) && p.expect(':') &&
+        p.read_range(&sec, 0, 59) && p.read_timezone(&tz);
+    p.optional('"');
+    if (!p.done()) {
+        return false;
+    }
+
+    memset(t, 0, sizeof(*t));
+    t->tm_year = year + 100;
+    t->tm_mon = month - 1;
+    t->tm_mday = day;
+    t->tm_hour = hour;
+    t->tm_min = min;
+    t->tm_sec = sec;
+    *tz_quarters = tz;
+    return true;
+}
+
+bool SIMCOM_SIM800_Parser::parse_http_action(const char *line, size_t len, int *method, int *status_code, int *data_len)
+{
+    SIMCOM_SIM800_Parser p(line, len);
+    int m, s, l;
+
+    p.skip_prefix("+HTTPACTION:");
+    p.read_range(&m, 0, 2) && p.expect(',') &&
+        p.read_range(&s, 0, 999) && p.expect(',') &&
+        p.read_range(&l, 0, INT_MAX);
+    if (!p.done()) {
+        return false;
+    }
+    *method = m;
+    *status_code = s;
+    *data_len = l;
+    return true;
+}
+
+bool SIMCOM_SIM800_Parser::parse_http_status(const char *line, size_t len, int *mode, int *status, int *finish, int *remain)
+{
+    SIMCOM_SIM800_Parser p(line, len);
+    char word[5];
+    int m = -1, s, f, r;
+
+    p.skip_prefix("+HTTPSTATUS:");
+    if (p.read_string(word, sizeof(word))) {
+        for (int i = 0; i < (int)(sizeof(http_modes) / sizeof(http_modes[0])); i++) {
+            if (strcmp(word, http_modes[i]) == 0) {
+                m = i;
+            }
+        }
+        if (m < 0) {
+            p.fail();
+        }
+    }
+    p.expect(',') && p.read_range(&s, 0, 2) && p.expect(',') &&
+        p.read_range(&f, 0, INT_MAX) && p.expect(',') &&
+        p.read_range(&r, 0, INT_MAX);
+    if (!p.done()) {
+        return false;
+    }
+    *mode = m;
+    *status = s;
+    *finish = f;
+    *remain = r;
+    return true;
+}
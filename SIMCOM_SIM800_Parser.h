@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_PARSER_H_
+#define SIMCOM_SIM800_PARSER_H_
+
+#include <stddef.h>
+#include <time.h>
+
+#define SIM800_RESPONSE_LINE_LENGTH 48  // Longest information response parsed through SIMCOM_SIM800_Parser
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_Parser
+ *
+ * Bounds-checked cursor over one modem result line, e.g. the remainder of an
+ * information response or URC. It never allocates and never reads past the
+ * given length. The first malformed field fails the parser, later reads
+ * return false without moving the cursor.
+ * Depends only on the C library, so it also builds for the host.
+ */
+class SIMCOM_SIM800_Parser {
+public:
+    SIMCOM_SIM800_Parser(const char *line, size_t len);
+
+    /** Skip the given prefix, e.g. "+CCLK:", when the line starts with it */
+    void skip_prefix(const char *prefix);
+
+    /** Decimal integer with optional sign, fails on overflow */
+    bool read_int(int *value);
+
+    /** Quoted string, or bare text up to the next ','. Fails if it does not fit in size - 1 bytes */
+    bool read_string(char *buf, size_t size);
+
+    /** Signed timezone in quarter hours, "+zz" or "-zz", within -48..+56 */
+    bool read_timezone(int *quarters);
+
+    /** Consume the separator c */
+    bool expect(char c);
+
+    /** Consume c if it is next, e.g. an optional quote */
+    void optional(char c);
+
+    /** Whole line consumed without error, trailing CR/LF and spaces allowed */
+    bool done();
+
+    bool ok() const
+    {
+        return _ok;
+    }
+
+    /** +CCLK: "yy/MM/dd,hh:mm:ss±zz" into a struct tm of the local modem time and its timezone */
+    static bool parse_clock(const char *line, size_t len, struct tm *t, int *tz_quarters);
+
+    /** +HTTPACTION: <method>,<status code>,<data length> */
+    static bool parse_http_action(const char *line, size_t len, int *method, int *status_code, int *data_len);
+
+    /** +HTTPSTATUS: <GET|POST|HEAD>,<status>,<finish>,<remain>, mode is returned as 0..2 */
+    static bool parse_http_status(const char *line, size_t len, int *mode, int *status, int *finish, int *remain);
+
+private:
+    void skip_spaces();
+    bool fail();
+    bool read_range(int *value, int min, int max);
+
+    const char *_pos;
+    const char *_end;
+    bool        _ok;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_PARSER_H_
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_SendDelay.h"
+#include "CellularLog.h"
+#include <string.h>
+
+using namespace mbed;
+
+// Candidate delays in ms, the last one is the former fixed PROPERTY_AT_SEND_DELAY
+static const uint16_t delay_steps[] = {0, 5, 10, 20, 50, 100, 200};
+static const int last_step = sizeof(delay_steps) / sizeof(delay_steps[0]) - 1;
+
+SIMCOM_SIM800_SendDelay::SIMCOM_SIM800_SendDelay(ATHandler &at, uint16_t delay_ms):
+    _at(at),
+    _step(last_step),
+    _floor_step(0),
+    _window_commands(0),
+    _window_errors(0),
+    _clean(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+    for (int i = 0; i <= last_step; i++) {
+        if (delay_steps[i] >= delay_ms) {
+            _step = i;
+            break;
+        }
+    }
+    _stats.delay_ms = delay_steps[_step];
+    _stats.calibrated_ms = delay_steps[_step];
+}
+
+void SIMCOM_SIM800_SendDelay::apply(int step)
+{
+    _step = step;
+    _stats.delay_ms = delay_steps[step];
+    _at.set_send_delay(delay_steps[step]);
+}
+
+bool SIMCOM_SIM800_SendDelay::probe()
+{
+    //+CSQ: <rssi>,<ber>
+    for (int i = 0; i < SIM800_SEND_DELAY_PROBES; i++) {
+        _stats.probes++;
+        _at.clear_error();
+        _at.cmd_start_stop("+CSQ", "");
+        _at.resp_start("+CSQ:");
+        int rssi = _at.read_int();
+        int ber = _at.read_int();
+        _at.resp_stop();
+        if (_at.get_last_error() != NSAPI_ERROR_OK ||
+                !((rssi >= 0 && rssi <= 31) || rssi == 99) || !((ber >= 0 && ber <= 7) || ber == 99)) {
+            _stats.probe_failures++;
+            _at.clear_error();
+            _at.flush();
+            return false;
+        }
+    }
+    return true;
+}
+
+uint16_t SIMCOM_SIM800_SendDelay::calibrate()
+{
+    int step = last_step;
+    for (int i = 0; i <= last_step; i++) {
+        apply(i);
+        if (probe()) {
+            step = i;
+            break;
+        }
+    }
+    apply(step);
+    _floor_step = step;
+    _window_commands = 0;
+    _window_errors = 0;
+    _clean = 0;
+    _stats.calibrated_ms = delay_steps[step];
+    tr_info("SIM800 AT send delay %u ms", (unsigned int)delay_steps[step]);
+    return delay_steps[step];
+}
+
+void SIMCOM_SIM800_SendDelay::record(bool garbled)
+{
+    // Callers hold the AT lock
+    _stats.commands++;
+    _window_commands++;
+    if (garbled) {
+        _stats.errors++;
+        _window_errors++;
+        _clean = 0;
+    } else {
+        _clean++;
+    }
+
+    if (_window_errors >= SIM800_SEND_DELAY_MAX_ERRORS) {
+        if (_step < last_step) {
+            apply(_step + 1);
+            _stats.raised++;
+            tr_info("SIM800 AT errors rising, send delay %u ms", (unsigned int)delay_steps[_step]);
+        }
+        _window_commands = 0;
+        _window_errors = 0;
+    } else if (_window_commands >= SIM800_SEND_DELAY_WINDOW) {
+        _window_commands = 0;
+        _window_errors = 0;
+    }
+
+    if (_clean >= SIM800_SEND_DELAY_RELAX && _step > _floor_step) {
+        apply(_step - 1);
+        _stats.lowered++;
+        _clean = 0;
+    }
+}
+
+void SIMCOM_SIM800_SendDelay::get_stats(send_delay_stats_t *stats) const
+{
+    *stats = _stats;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_SENDDELAY_H_
+#define SIMCOM_SIM800_SENDDELAY_H_
+
+#include "ATHandler.h"
+#include <stdint.h>
+
+#ifndef MBED_CONF_SIMCOM_SIM800_SEND_DELAY_CALIBRATION
+#define MBED_CONF_SIMCOM_SIM800_SEND_DELAY_CALIBRATION 0
+#endif
+
+#define SIM800_SEND_DELAY_PROBES        8   // Back-to-back probes per candidate delay
+#define SIM800_SEND_DELAY_WINDOW        32  // Commands per error rate window
+#define SIM800_SEND_DELAY_MAX_ERRORS    3   // Garbled results in a window that raise the delay
+#define SIM800_SEND_DELAY_RELAX         512 // Clean commands in a row before trying a lower delay
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_SendDelay
+ *
+ * Picks the ATHandler delay between commands. calibrate() tries the candidate
+ * delays from the lowest up and keeps the first one at which a burst of +CSQ
+ * probes comes back intact. At runtime, plain ERROR results and unanswered
+ * commands count as garbled. Too many in a window raise the delay one step,
+ * and a long clean run lowers it again down to the calibrated value.
+ */
+class SIMCOM_SIM800_SendDelay {
+public:
+    typedef struct send_delay_stats
+    {
+    uint16_t      delay_ms;         // Current delay
+    uint16_t      calibrated_ms;    // Result of the last calibration
+    unsigned int  probes;           // Calibration probes sent
+    unsigned int  probe_failures;   // Probes with a garbled or missing response
+    unsigned int  commands;         // Commands seen at runtime
+    unsigned int  errors;           // Garbled results seen at runtime
+    unsigned int  raised;           // Runtime steps up
+    unsigned int  lowered;          // Runtime steps down
+    }send_delay_stats_t;
+
+    SIMCOM_SIM800_SendDelay(ATHandler &at, uint16_t delay_ms);
+
+    /** Find the lowest safe delay and apply it. Call with the AT lock held.
+     *
+     *  @return the chosen delay in ms
+     */
+    uint16_t calibrate();
+
+    /** Account one command result, see SIMCOM_SIM800_Timing::attach() */
+    void record(bool garbled);
+
+    void get_stats(send_delay_stats_t *stats) const;
+
+private:
+    bool probe();
+    void apply(int step);
+
+    ATHandler          &_at;
+    int                 _step;
+    int                 _floor_step;
+    unsigned int        _window_commands;
+    unsigned int        _window_errors;
+    unsigned int        _clean;
+    send_delay_stats_t  _stats;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_SENDDELAY_H_
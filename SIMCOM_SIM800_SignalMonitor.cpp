@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_SignalMonitor.h"
+#include "CellularLog.h"
+#include "platform/ScopedLock.h"
+
+using namespace mbed;
+using namespace std::chrono;
+
+SIMCOM_SIM800_SignalMonitor::SIMCOM_SIM800_SignalMonitor(CellularNetwork &network, int rssi_threshold):
+    _network(network),
+    _threshold(rssi_threshold),
+    _rssi(SIGNAL_RSSI_UNKNOWN),
+    _ber(99),
+    _registered(false),
+    _valid(false)
+{
+}
+
+nsapi_error_t SIMCOM_SIM800_SignalMonitor::refresh()
+{
+    int rssi, ber;
+    CellularNetwork::registration_params_t reg;
+    nsapi_error_t err = _network.get_signal_quality(rssi, &ber);
+    if (err == NSAPI_ERROR_OK) {
+        err = _network.get_registration_params(CellularNetwork::C_GREG, reg);
+    }
+    if (err != NSAPI_ERROR_OK) {
+        return err;
+    }
+
+    // get_signal_quality() reports dBm, keep the +CSQ scale of the threshold
+    if (rssi != CellularNetwork::SignalQualityUnknown) {
+        rssi = (rssi + 113) / 2;
+    }
+    _rssi = (rssi >= 0 && rssi <= 31) ? rssi : SIGNAL_RSSI_UNKNOWN;
+    _ber = (ber >= 0 && ber <= 7) ? ber : 99;
+    _registered = (reg._status == CellularNetwork::RegisteredHomeNetwork ||
+                   reg._status == CellularNetwork::RegisteredRoaming);
+    _sampled = rtos::Kernel::Clock::now();
+    _valid = true;
+    tr_debug("Signal rssi %d ber %d registered %d", _rssi, _ber, _registered);
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t SIMCOM_SIM800_SignalMonitor::get_quality(link_quality_t *quality, bool force)
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    nsapi_error_t err = NSAPI_ERROR_OK;
+    auto now = rtos::Kernel::Clock::now();
+    if (force || !_valid || now - _sampled >= milliseconds(MBED_CONF_SIMCOM_SIM800_SIGNAL_CACHE_TTL)) {
+        err = refresh();
+        now = rtos::Kernel::Clock::now();
+    }
+    quality->rssi = _rssi;
+    quality->ber = _ber;
+    quality->registered = _registered;
+    quality->age = _valid ? duration_cast<milliseconds>(now - _sampled) : milliseconds::max();
+    return err;
+}
+
+bool SIMCOM_SIM800_SignalMonitor::is_good()
+{
+    link_quality_t q;
+    if (get_quality(&q) != NSAPI_ERROR_OK && q.age == milliseconds::max()) {
+        return false;
+    }
+    return q.registered && q.rssi != SIGNAL_RSSI_UNKNOWN && q.rssi >= _threshold;
+}
+
+void SIMCOM_SIM800_SignalMonitor::set_threshold(int rssi)
+{
+    _threshold = rssi;
+}
+
+int SIMCOM_SIM800_SignalMonitor::get_threshold() const
+{
+    return _threshold;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_SIGNALMONITOR_H_
+#define SIMCOM_SIM800_SIGNALMONITOR_H_
+
+#include "CellularNetwork.h"
+#include "rtos/Kernel.h"
+#include "rtos/Mutex.h"
+#include <chrono>
+
+#ifndef MBED_CONF_SIMCOM_SIM800_SIGNAL_CACHE_TTL
+#define MBED_CONF_SIMCOM_SIM800_SIGNAL_CACHE_TTL 10000
+#endif
+#ifndef MBED_CONF_SIMCOM_SIM800_SIGNAL_RSSI_THRESHOLD
+#define MBED_CONF_SIMCOM_SIM800_SIGNAL_RSSI_THRESHOLD 10
+#endif
+
+#define SIGNAL_RSSI_UNKNOWN 99
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_SignalMonitor
+ *
+ * Cached link quality from CellularNetwork: +CSQ and the GPRS registration
+ * (+CGREG), which is what HTTP and the bearer need. The modem is only asked
+ * when the cached sample is older than signal-cache-ttl ms, so callers may
+ * check the link before every transfer.
+ */
+class SIMCOM_SIM800_SignalMonitor {
+public:
+    typedef struct link_quality
+    {
+    int   rssi;         // +CSQ 0..31 (-115..-52 dBm), SIGNAL_RSSI_UNKNOWN if not known
+    int   ber;          // +CSQ 0..7, 99 if not known
+    bool  registered;   // +CGREG home or roaming
+    std::chrono::milliseconds age; // Since the modem was asked
+    }link_quality_t;
+
+    SIMCOM_SIM800_SignalMonitor(CellularNetwork &network, int rssi_threshold = MBED_CONF_SIMCOM_SIM800_SIGNAL_RSSI_THRESHOLD);
+
+    /** Cached quality, refreshed from the modem once the TTL has passed or if forced.
+     *
+     *  @return NSAPI_ERROR_OK, or the AT error of the refresh; the stale sample is returned then
+     */
+    nsapi_error_t get_quality(link_quality_t *quality, bool force = false);
+
+    /** Registered and rssi at or above the threshold */
+    bool is_good();
+
+    void set_threshold(int rssi);
+    int get_threshold() const;
+
+private:
+    nsapi_error_t refresh();
+
+    CellularNetwork &_network;
+    int             _threshold;
+    int             _rssi;
+    int             _ber;
+    bool            _registered;
+    bool            _valid;
+    rtos::Kernel::Clock::time_point _sampled;
+    rtos::Mutex     _mutex;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_SIGNALMONITOR_H_
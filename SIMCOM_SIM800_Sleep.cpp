@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_Sleep.h"
+#include "CellularLog.h"
+#include "platform/ScopedLock.h"
+#include "platform/mbed_atomic.h"
+#include "rtos/ThisThread.h"
+#include <string.h>
+
+using namespace mbed;
+using namespace std::chrono;
+
+uint32_t SIMCOM_SIM800_Sleep::_holds = 0;
+
+SIMCOM_SIM800_Sleep::SIMCOM_SIM800_Sleep(FileHandle *fh, PinName dtr):
+    _fh(fh),
+    _dtr(dtr, 0),
+    _queue(nullptr),
+    _at(nullptr),
+    _idle(0),
+    _idle_id(0),
+    _asleep(false),
+    _wake_pending(false)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+SIMCOM_SIM800_Sleep::~SIMCOM_SIM800_Sleep()
+{
+    stop();
+}
+
+void SIMCOM_SIM800_Sleep::start(events::EventQueue *queue, milliseconds idle, ATHandler *at)
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    if (!_dtr.is_connected() || idle == 0ms) {
+        return;
+    }
+    _queue = queue;
+    _at = at;
+    _idle = idle;
+    _last_activity = rtos::Kernel::Clock::now();
+    schedule_idle(_idle);
+}
+
+void SIMCOM_SIM800_Sleep::stop()
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    if (_idle_id) {
+        _queue->cancel(_idle_id);
+        _idle_id = 0;
+    }
+    _idle = 0ms;
+    wake();
+}
+
+void SIMCOM_SIM800_Sleep::hold()
+{
+    core_util_atomic_incr_u32(&_holds, 1);
+}
+
+void SIMCOM_SIM800_Sleep::release()
+{
+    core_util_atomic_decr_u32(&_holds, 1);
+}
+
+bool SIMCOM_SIM800_Sleep::is_asleep() const
+{
+    return _asleep;
+}
+
+void SIMCOM_SIM800_Sleep::get_stats(sleep_stats_t *stats) const
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    *stats = _stats;
+    if (_asleep) {
+        stats->asleep_ms += duration_cast<milliseconds>(rtos::Kernel::Clock::now() - _sleep_start).count();
+    }
+}
+
+void SIMCOM_SIM800_Sleep::reset_stats()
+{
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    memset(&_stats, 0, sizeof(_stats));
+    if (_asleep) {
+        _sleep_start = rtos::Kernel::Clock::now();
+    }
+}
+
+void SIMCOM_SIM800_Sleep::wake()
+{
+    // Called with _mutex held. Only starts the wake-up, the caller waits for
+    // _wake_ready without the mutex so read() is not blocked meanwhile.
+    if (!_asleep) {
+        return;
+    }
+    _dtr = 0;
+    auto now = rtos::Kernel::Clock::now();
+    _stats.asleep_ms += duration_cast<milliseconds>(now - _sleep_start).count();
+    _stats.wakes++;
+    _asleep = false;
+    _wake_pending = true;
+    _wake_start = now;
+    _wake_ready = now + SIM800_DTR_WAKE_DELAY;
+    if (_idle != 0ms) {
+        schedule_idle(_idle);
+    }
+}
+
+void SIMCOM_SIM800_Sleep::schedule_idle(milliseconds delay)
+{
+    if (_idle_id == 0) {
+        _idle_id = _queue->call_in(delay, this, &SIMCOM_SIM800_Sleep::idle_check);
+    }
+}
+
+void SIMCOM_SIM800_Sleep::idle_check()
+{
+    // AT lock first, the same order as ATHandler -> write(). Holding it means
+    // no command is waiting for its response and none starts before DTR is up.
+    _at->lock();
+    ScopedLock<rtos::Mutex> lock(_mutex);
+    _idle_id = 0;
+    if (_asleep || _idle == 0ms) {
+        _at->unlock();
+        return;
+    }
+    if (core_util_atomic_load_u32(&_holds)) {
+        schedule_idle(_idle);
+        _at->unlock();
+        return;
+    }
+    auto idle_for = duration_cast<milliseconds>(rtos::Kernel::Clock::now() - _last_activity);
+    if (idle_for < _idle) {
+        schedule_idle(_idle - idle_for);
+        _at->unlock();
+        return;
+    }
+    tr_debug("SIM800 sleep after %d ms idle", (int)idle_for.count());
+    _dtr = 1;
+    _asleep = true;
+    _sleep_start = rtos::Kernel::Clock::now();
+    _stats.sleeps++;
+    _at->unlock();
+}
+
+ssize_t SIMCOM_SIM800_Sleep::read(void *buffer, size_t size)
+{
+    ssize_t n = _fh->read(buffer, size);
+    if (n > 0) {
+        ScopedLock<rtos::Mutex> lock(_mutex);
+        _last_activity = rtos::Kernel::Clock::now();
+        if (_wake_pending) {
+            uint32_t latency = duration_cast<milliseconds>(_last_activity - _wake_start).count();
+            _wake_pending = false;
+            _stats.wake_last_ms = latency;
+            _stats.wake_total_ms += latency;
+            _stats.wake_samples++;
+            if (latency > _stats.wake_max_ms) {
+                _stats.wake_max_ms = latency;
+            }
+        }
+    }
+    return n;
+}
+
+ssize_t SIMCOM_SIM800_Sleep::write(const void *buffer, size_t size)
+{
+    rtos::Kernel::Clock::time_point ready;
+    {
+        ScopedLock<rtos::Mutex> lock(_mutex);
+        wake();
+        _last_activity = rtos::Kernel::Clock::now();
+        ready = _wake_ready;
+    }
+    auto now = rtos::Kernel::Clock::now();
+    if (now < ready) {
+        rtos::ThisThread::sleep_for(duration_cast<milliseconds>(ready - now));
+    }
+    return _fh->write(buffer, size);
+}
+
+off_t SIMCOM_SIM800_Sleep::seek(off_t offset, int whence)
+{
+    return _fh->seek(offset, whence);
+}
+
+int SIMCOM_SIM800_Sleep::close()
+{
+    return _fh->close();
+}
+
+int SIMCOM_SIM800_Sleep::set_blocking(bool blocking)
+{
+    return _fh->set_blocking(blocking);
+}
+
+bool SIMCOM_SIM800_Sleep::is_blocking() const
+{
+    return _fh->is_blocking();
+}
+
+short SIMCOM_SIM800_Sleep::poll(short events) const
+{
+    return _fh->poll(events);
+}
+
+void SIMCOM_SIM800_Sleep::sigio(Callback<void()> func)
+{
+    _fh->sigio(func);
+}
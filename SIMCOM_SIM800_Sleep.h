@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_SLEEP_H_
+#define SIMCOM_SIM800_SLEEP_H_
+
+#include "ATHandler.h"
+#include "platform/FileHandle.h"
+#include "platform/Callback.h"
+#include "drivers/DigitalOut.h"
+#include "events/EventQueue.h"
+#include "rtos/Kernel.h"
+#include "rtos/Mutex.h"
+#include <chrono>
+#include <stdint.h>
+
+#ifndef MBED_CONF_SIMCOM_SIM800_SLEEP_IDLE_TIME
+#define MBED_CONF_SIMCOM_SIM800_SLEEP_IDLE_TIME 0
+#endif
+
+#define SIM800_DTR_WAKE_DELAY 50ms  // Serial port is usable ~50 ms after DTR goes low
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_Sleep
+ *
+ * FileHandle placed between the ATHandler and the serial port to run the
+ * modem in slow clock mode (AT+CSCLK=1). After the idle time without UART
+ * traffic DTR is raised and the modem sleeps, network registration and the
+ * bearer are kept. The next write pulls DTR low and waits for the serial
+ * port to come up, so every AT user wakes the modem without knowing about it.
+ *
+ * DTR is only raised while the ATHandler is unlocked, so a command waiting for
+ * its response keeps the modem awake. Waits outside the AT lock (URCs, data
+ * mode) take a hold() reference instead.
+ */
+class SIMCOM_SIM800_Sleep : public FileHandle {
+public:
+    typedef struct sleep_stats
+    {
+    unsigned int  sleeps;           // Times the modem was put to sleep
+    unsigned int  wakes;            // Wake-ups by the driver
+    uint64_t      asleep_ms;        // Total time with DTR high, including the current sleep
+    uint32_t      wake_last_ms;     // DTR low until the first byte from the modem
+    uint32_t      wake_max_ms;      //
+    uint32_t      wake_total_ms;    // Sum of measured wake latencies, divide by wake_samples
+    unsigned int  wake_samples;     //
+    }sleep_stats_t;
+
+    SIMCOM_SIM800_Sleep(FileHandle *fh, PinName dtr);
+    virtual ~SIMCOM_SIM800_Sleep();
+
+    /** Start idle tracking. The modem must have been set to AT+CSCLK=1.
+     *
+     *  @param at   ATHandler using this FileHandle, locked before DTR is raised
+     */
+    void start(events::EventQueue *queue, std::chrono::milliseconds idle, ATHandler *at);
+    /** Stop idle tracking and keep the modem awake */
+    void stop();
+
+    /** Keep the modem awake until the matching release(), e.g. while waiting for a URC
+     *  or in transparent data mode. Counted, callable from any thread.
+     */
+    static void hold();
+    static void release();
+
+    bool is_asleep() const;
+    void get_stats(sleep_stats_t *stats) const;
+    void reset_stats();
+
+public: // FileHandle
+    virtual ssize_t read(void *buffer, size_t size);
+    virtual ssize_t write(const void *buffer, size_t size);
+    virtual off_t seek(off_t offset, int whence = SEEK_SET);
+    virtual int close();
+    virtual int set_blocking(bool blocking);
+    virtual bool is_blocking() const;
+    virtual short poll(short events) const;
+    virtual void sigio(Callback<void()> func);
+
+private:
+    void wake();
+    void schedule_idle(std::chrono::milliseconds delay);
+    void idle_check();
+
+    FileHandle         *_fh;
+    DigitalOut          _dtr;
+    events::EventQueue *_queue;
+    ATHandler          *_at;
+    std::chrono::milliseconds _idle;
+    int                 _idle_id;
+    bool                _asleep;
+    bool                _wake_pending;  // Waiting for the first byte after a wake-up
+    rtos::Kernel::Clock::time_point _last_activity;
+    rtos::Kernel::Clock::time_point _sleep_start;
+    rtos::Kernel::Clock::time_point _wake_start;
+    rtos::Kernel::Clock::time_point _wake_ready;    // Serial port usable from here
+    static uint32_t     _holds;
+    sleep_stats_t       _stats;
+    mutable rtos::Mutex _mutex;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_SLEEP_H_
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_Stats.h"
+
+#if MBED_CONF_SIMCOM_SIM800_INSTRUMENTATION
+
+#include "platform/mbed_critical.h"
+#include "hal/us_ticker_api.h"
+#include <string.h>
+
+using namespace mbed;
+
+static const uint32_t bucket_limits_ms[SIM800_STATS_BUCKETS - 1] = {10, 50, 100, 250, 500, 1000, 5000};
+
+static const char *const family_names[SIM800_CMD_COUNT] = {
+    "init", "baud", "boot", "SAPBR", "SAPBR open", "HTTPINIT", "HTTPPARA", "HTTPDATA", "HTTPACTION", "HTTPREAD"
+};
+
+static sim800_stats_t stats;
+
+void SIMCOM_SIM800_Stats::record(sim800_cmd_family_t family, uint32_t elapsed_us, unsigned int retries,
+                                 size_t bytes_tx, size_t bytes_rx, bool error)
+{
+    uint32_t elapsed_ms = elapsed_us / 1000;
+    int bucket = 0;
+    while (bucket < SIM800_STATS_BUCKETS - 1 && elapsed_ms >= bucket_limits_ms[bucket]) {
+        bucket++;
+    }
+
+    core_util_critical_section_enter();
+    sim800_cmd_stats_t &s = stats.cmd[family];
+    s.calls++;
+    s.retries += retries;
+    s.errors += error ? 1 : 0;
+    s.bytes_tx += bytes_tx;
+    s.bytes_rx += bytes_rx;
+    s.total_ms += elapsed_ms;
+    if (elapsed_ms > s.max_ms) {
+        s.max_ms = elapsed_ms;
+    }
+    s.latency[bucket]++;
+    core_util_critical_section_exit();
+}
+
+void SIMCOM_SIM800_Stats::lock(ATHandler &at)
+{
+    uint32_t start = us_ticker_read();
+    at.lock();
+    uint32_t waited = us_ticker_read() - start;
+
+    core_util_critical_section_enter();
+    stats.lock.count++;
+    stats.lock.total_us += waited;
+    if (waited > stats.lock.max_us) {
+        stats.lock.max_us = waited;
+    }
+    core_util_critical_section_exit();
+}
+
+void SIMCOM_SIM800_Stats::snapshot(sim800_stats_t *out)
+{
+    core_util_critical_section_enter();
+    *out = stats;
+    core_util_critical_section_exit();
+}
+
+void SIMCOM_SIM800_Stats::reset()
+{
+    core_util_critical_section_enter();
+    memset(&stats, 0, sizeof(stats));
+    core_util_critical_section_exit();
+}
+
+const char *SIMCOM_SIM800_Stats::family_name(sim800_cmd_family_t family)
+{
+    return (family >= 0 && family < SIM800_CMD_COUNT) ? family_names[family] : "";
+}
+
+uint32_t SIMCOM_SIM800_Stats::bucket_limit(int bucket)
+{
+    return (bucket >= 0 && bucket < SIM800_STATS_BUCKETS - 1) ? bucket_limits_ms[bucket] : 0;
+}
+
+SIMCOM_SIM800_StatsScope::SIMCOM_SIM800_StatsScope(sim800_cmd_family_t family):
+    _family(family), _start(us_ticker_read()), _retries(0), _tx(0), _rx(0), _error(false)
+{
+}
+
+SIMCOM_SIM800_StatsScope::~SIMCOM_SIM800_StatsScope()
+{
+    SIMCOM_SIM800_Stats::record(_family, us_ticker_read() - _start, _retries, _tx, _rx, _error);
+}
+
+#endif // MBED_CONF_SIMCOM_SIM800_INSTRUMENTATION
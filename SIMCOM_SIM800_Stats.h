@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_STATS_H_
+#define SIMCOM_SIM800_STATS_H_
+
+#include "ATHandler.h"
+#include "platform/NonCopyable.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef MBED_CONF_SIMCOM_SIM800_INSTRUMENTATION
+#define MBED_CONF_SIMCOM_SIM800_INSTRUMENTATION 0
+#endif
+
+#define SIM800_STATS_BUCKETS 8      // Latency histogram buckets, see SIMCOM_SIM800_Stats::bucket_limit()
+
+namespace mbed {
+
+typedef enum sim800_cmd_family
+{
+    SIM800_CMD_INIT = 0,    // Setup batch of SIMCOM_SIM800::init()
+    SIM800_CMD_BAUD,        // +IPR negotiation
+    SIM800_CMD_BOOT,        // Readiness probes after power on
+    SIM800_CMD_SAPBR,
+    SIM800_CMD_SAPBR_OPEN,  // +SAPBR=1,1, includes the network attach
+    SIM800_CMD_HTTPINIT,    // +HTTPINIT and +HTTPTERM
+    SIM800_CMD_HTTPPARA,    // Single +HTTPPARA/+HTTPSSL and parameter batches
+    SIM800_CMD_HTTPDATA,
+    SIM800_CMD_HTTPACTION,  // Command until the +HTTPACTION URC
+    SIM800_CMD_HTTPREAD,
+    SIM800_CMD_COUNT
+}sim800_cmd_family_t;
+
+typedef struct sim800_cmd_stats
+{
+uint32_t  calls;                            //
+uint32_t  retries;                          // Repeated attempts inside a call
+uint32_t  errors;                           // Calls that ended in an error
+uint32_t  bytes_tx;                         // Payload bytes sent, e.g. parameter values and body
+uint32_t  bytes_rx;                         // Payload bytes received
+uint32_t  total_ms;                         //
+uint32_t  max_ms;                           //
+uint32_t  latency[SIM800_STATS_BUCKETS];    // Calls per latency bucket
+}sim800_cmd_stats_t;
+
+typedef struct sim800_lock_stats
+{
+uint32_t  count;                            // ATHandler::lock() calls
+uint32_t  total_us;                         // Time spent waiting for the lock
+uint32_t  max_us;                           //
+}sim800_lock_stats_t;
+
+typedef struct sim800_stats
+{
+sim800_cmd_stats_t   cmd[SIM800_CMD_COUNT];
+sim800_lock_stats_t  lock;
+}sim800_stats_t;
+
+#if MBED_CONF_SIMCOM_SIM800_INSTRUMENTATION
+
+/**
+ * Class SIMCOM_SIM800_Stats
+ *
+ * Driver wide AT command counters, enabled with the "instrumentation" config.
+ * Counters live in static storage and are updated in a critical section, so
+ * a snapshot is a consistent copy without heap allocation.
+ */
+class SIMCOM_SIM800_Stats {
+public:
+    static void record(sim800_cmd_family_t family, uint32_t elapsed_us, unsigned int retries,
+                       size_t bytes_tx, size_t bytes_rx, bool error);
+
+    /** ATHandler::lock() that records the time spent waiting */
+    static void lock(ATHandler &at);
+
+    static void snapshot(sim800_stats_t *stats);
+    static void reset();
+
+    static const char *family_name(sim800_cmd_family_t family);
+    /** Upper latency bound in ms of a histogram bucket, 0 for the last, open ended one */
+    static uint32_t bucket_limit(int bucket);
+};
+
+/**
+ * Class SIMCOM_SIM800_StatsScope
+ *
+ * Times one call of a command family and records it when it goes out of scope.
+ */
+class SIMCOM_SIM800_StatsScope : private NonCopyable<SIMCOM_SIM800_StatsScope> {
+public:
+    SIMCOM_SIM800_StatsScope(sim800_cmd_family_t family);
+    ~SIMCOM_SIM800_StatsScope();
+
+    void retry() { _retries++; }
+    void tx(size_t len) { _tx += len; }
+    void rx(size_t len) { _rx += len; }
+    void result(bool failed) { _error = failed; }
+
+private:
+    sim800_cmd_family_t _family;
+    uint32_t            _start;
+    unsigned int        _retries;
+    size_t              _tx;
+    size_t              _rx;
+    bool                _error;
+};
+
+#define SIM800_STATS_SCOPE(name, family)    SIMCOM_SIM800_StatsScope name(family)
+#define SIM800_STATS_RETRY(name)            (name).retry()
+#define SIM800_STATS_TX(name, len)          (name).tx(len)
+#define SIM800_STATS_RX(name, len)          (name).rx(len)
+#define SIM800_STATS_RESULT(name, failed)   (name).result(failed)
+#define SIM800_AT_LOCK(at)                  SIMCOM_SIM800_Stats::lock(at)
+
+#else
+
+// Arguments are not evaluated when instrumentation is disabled
+#define SIM800_STATS_SCOPE(name, family)
+#define SIM800_STATS_RETRY(name)            do {} while (0)
+#define SIM800_STATS_TX(name, len)          do {} while (0)
+#define SIM800_STATS_RX(name, len)          do {} while (0)
+#define SIM800_STATS_RESULT(name, failed)   do {} while (0)
+#define SIM800_AT_LOCK(at)                  (at).lock()
+
+#endif // MBED_CONF_SIMCOM_SIM800_INSTRUMENTATION
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_STATS_H_
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_Timing.h"
+#include "platform/mbed_critical.h"
+#include "hal/us_ticker_api.h"
+
+using namespace mbed;
+using namespace std::chrono;
+
+typedef struct family_timing
+{
+int           srtt_ms;
+int           rttvar_ms;
+unsigned int  samples;
+unsigned int  timeouts;
+int           backoff;
+}family_timing_t;
+
+#define MAX_BACKOFF 6
+
+static family_timing_t timing[SIM800_CMD_COUNT];
+static uint32_t jitter_state;
+static int baud_rate = MBED_CONF_SIMCOM_SIM800_BAUDRATE;
+static SIMCOM_SIM800_Timing::observer_t observer;
+
+milliseconds SIMCOM_SIM800_Timing::timeout(sim800_cmd_family_t family, milliseconds floor, milliseconds cap)
+{
+#if MBED_CONF_SIMCOM_SIM800_ADAPTIVE_TIMEOUTS
+    core_util_critical_section_enter();
+    family_timing_t t = timing[family];
+    core_util_critical_section_exit();
+    if (t.samples == 0) {
+        return cap;
+    }
+
+    milliseconds var = milliseconds(4 * t.rttvar_ms);
+    milliseconds rto = milliseconds(t.srtt_ms) + (var > SIM800_TIMING_GRANULARITY ? var : SIM800_TIMING_GRANULARITY);
+    rto *= 1 << t.backoff;
+    if (floor < SIM800_TIMING_MIN_TIMEOUT) {
+        floor = SIM800_TIMING_MIN_TIMEOUT;
+    }
+    if (rto < floor) {
+        rto = floor;
+    }
+    return rto < cap ? rto : cap;
+#else
+    return cap;
+#endif
+}
+
+void SIMCOM_SIM800_Timing::complete(sim800_cmd_family_t family, ATHandler &at, time_point start, milliseconds excluded)
+{
+    // ERROR and +CME ERROR are answers, a bare failure means the read timed out
+    DeviceErrorType type = at.get_last_device_error().errType;
+    bool failed = at.get_last_error() != NSAPI_ERROR_OK;
+    bool answered = !failed || type != DeviceErrorTypeNoError;
+    if (observer) {
+        observer(!answered || (failed && type == DeviceErrorTypeError));
+    }
+    int rtt = duration_cast<milliseconds>(rtos::Kernel::Clock::now() - start - excluded).count();
+    if (rtt < 0) {
+        rtt = 0;
+    }
+
+    core_util_critical_section_enter();
+    family_timing_t &t = timing[family];
+    if (!answered) {
+        t.timeouts++;
+        if (t.backoff < MAX_BACKOFF) {
+            t.backoff++;
+        }
+    } else if (t.samples == 0) {
+        t.srtt_ms = rtt;
+        t.rttvar_ms = rtt / 2;
+        t.samples = 1;
+        t.backoff = 0;
+    } else {
+        int delta = t.srtt_ms > rtt ? t.srtt_ms - rtt : rtt - t.srtt_ms;
+        t.rttvar_ms = (3 * t.rttvar_ms + delta) / 4;
+        t.srtt_ms = (7 * t.srtt_ms + rtt) / 8;
+        t.samples++;
+        t.backoff = 0;
+    }
+    core_util_critical_section_exit();
+}
+
+milliseconds SIMCOM_SIM800_Timing::backoff(int attempt, milliseconds base, milliseconds cap)
+{
+    milliseconds delay = base;
+    for (int i = 2; i < attempt && delay < cap; i++) {
+        delay *= 2;
+    }
+    if (delay > cap) {
+        delay = cap;
+    }
+#if MBED_CONF_SIMCOM_SIM800_ADAPTIVE_TIMEOUTS
+    return jitter(delay);
+#else
+    return base;
+#endif
+}
+
+milliseconds SIMCOM_SIM800_Timing::jitter(milliseconds delay)
+{
+    // xorshift32, seeded on first use. Boot time in us differs between
+    // devices powered up together, the ms clock alone often does not.
+    core_util_critical_section_enter();
+    uint32_t x = jitter_state;
+    if (!x) {
+        x = ((uint32_t)rtos::Kernel::Clock::now().time_since_epoch().count() * 2654435761u) ^ us_ticker_read();
+        x |= 1;
+    }
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    jitter_state = x;
+    core_util_critical_section_exit();
+
+    // Keep half of the delay, spread the other half so retries do not line up
+    milliseconds half = delay / 2;
+    return half + milliseconds(half.count() ? x % (delay.count() - half.count() + 1) : 0);
+}
+
+void SIMCOM_SIM800_Timing::get_estimate(sim800_cmd_family_t family, timing_estimate_t *estimate)
+{
+    core_util_critical_section_enter();
+    family_timing_t t = timing[family];
+    core_util_critical_section_exit();
+    estimate->srtt_ms = t.samples ? t.srtt_ms : -1;
+    estimate->rttvar_ms = t.rttvar_ms;
+    estimate->samples = t.samples;
+    estimate->timeouts = t.timeouts;
+    estimate->backoff = t.backoff;
+}
+
+void SIMCOM_SIM800_Timing::set_baud_rate(int baud)
+{
+    baud_rate = baud;
+}
+
+milliseconds SIMCOM_SIM800_Timing::transfer_time(size_t bytes)
+{
+    // 64-bit, bytes * 10000 overflows 32 bits above ~429 kB
+    return milliseconds((uint64_t)bytes * 10 * 1000 / (uint64_t)baud_rate);
+}
+
+void SIMCOM_SIM800_Timing::attach(observer_t cb)
+{
+    observer = cb;
+}
+
+void SIMCOM_SIM800_Timing::reset()
+{
+    core_util_critical_section_enter();
+    for (int i = 0; i < SIM800_CMD_COUNT; i++) {
+        timing[i] = family_timing_t();
+    }
+    core_util_critical_section_exit();
+}
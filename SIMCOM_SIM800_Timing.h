@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_TIMING_H_
+#define SIMCOM_SIM800_TIMING_H_
+
+#include "ATHandler.h"
+#include "SIMCOM_SIM800_Stats.h"
+#include "platform/Callback.h"
+#include "rtos/Kernel.h"
+#include <chrono>
+
+#ifndef MBED_CONF_SIMCOM_SIM800_ADAPTIVE_TIMEOUTS
+#define MBED_CONF_SIMCOM_SIM800_ADAPTIVE_TIMEOUTS 0
+#endif
+
+#define SIM800_TIMING_MIN_TIMEOUT   300ms   // Lowest derived timeout
+#define SIM800_TIMING_GRANULARITY   100ms   // Lower bound of the variance term
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_Timing
+ *
+ * AT timeout and retry policy shared by the driver classes. Each command
+ * family keeps a smoothed response time and its variance (RFC 6298). The
+ * timeout is SRTT + 4 * RTTVAR, doubled for every timeout in a row and kept
+ * between a floor and the caller's worst-case constant. A family without
+ * samples gets the constant. Retries sleep with jittered exponential backoff.
+ */
+class SIMCOM_SIM800_Timing {
+public:
+    typedef rtos::Kernel::Clock::time_point time_point;
+
+    /** Told about every completed exchange. garbled is set for a plain ERROR, which
+     *  SIM800 answers to a command it could not parse, and for no answer at all.
+     */
+    typedef Callback<void(bool garbled)> observer_t;
+
+    typedef struct timing_estimate
+    {
+    int           srtt_ms;      // Smoothed response time, -1 without samples
+    int           rttvar_ms;    //
+    unsigned int  samples;      //
+    unsigned int  timeouts;     // Commands that got no answer
+    int           backoff;      // Timeouts in a row, each doubles the timeout
+    }timing_estimate_t;
+
+    /** Timeout for the next command of a family
+     *
+     *  @param floor  lowest timeout, e.g. to cover the transfer time of a body
+     *  @param cap    worst-case constant, used until the family has samples
+     */
+    static std::chrono::milliseconds timeout(sim800_cmd_family_t family, std::chrono::milliseconds floor,
+                                             std::chrono::milliseconds cap);
+
+    static time_point start()
+    {
+        return rtos::Kernel::Clock::now();
+    }
+
+    /** Account one exchange started at start. A command the modem answered, with OK
+     *  or an error, is a response time sample. No answer at all backs the timeout off.
+     *
+     *  @param excluded  part of the elapsed time not spent waiting for the modem, e.g. the body transfer
+     */
+    static void complete(sim800_cmd_family_t family, ATHandler &at, time_point start,
+                         std::chrono::milliseconds excluded = std::chrono::milliseconds(0));
+
+    /** Sleep before retry attempt (2, 3, ...): base * 2^(attempt - 2) capped, half of it jittered */
+    static std::chrono::milliseconds backoff(int attempt, std::chrono::milliseconds base, std::chrono::milliseconds cap);
+
+    /** Random delay in [delay/2, delay], also when adaptive-timeouts is disabled */
+    static std::chrono::milliseconds jitter(std::chrono::milliseconds delay);
+
+    /** Host UART rate for transfer_time(), set by SIMCOM_SIM800 whenever it changes the rate */
+    static void set_baud_rate(int baud);
+
+    /** Time to send bytes over the UART at the current rate, 10 bits per byte */
+    static std::chrono::milliseconds transfer_time(size_t bytes);
+
+    static void get_estimate(sim800_cmd_family_t family, timing_estimate_t *estimate);
+    static void attach(observer_t observer);
+    static void reset();
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_TIMING_H_
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_TransparentSocket.h"
+#include "SIMCOM_SIM800_CellularContext.h"
+#include "SIMCOM_SIM800_ATBatch.h"
+#include "SIMCOM_SIM800_Sleep.h"
+#include "CellularLog.h"
+#include "rtos/ThisThread.h"
+#include <errno.h>
+#include <string.h>
+
+using namespace mbed;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+volatile bool SIMCOM_SIM800_TransparentSocket::_in_use = false;
+
+SIMCOM_SIM800_TransparentSocket::SIMCOM_SIM800_TransparentSocket(AT_CellularDevice &device):
+    _at(*device.get_at_handler()),
+    _fh(nullptr),
+    _apn(nullptr),
+    _uname(nullptr),
+    _pwd(nullptr),
+    _connected(false),
+    _data_mode(false)
+{
+    _config.retries = MBED_CONF_SIMCOM_SIM800_TRANSPARENT_RETRIES;
+    _config.wait_time = MBED_CONF_SIMCOM_SIM800_TRANSPARENT_WAIT_TIME;
+    _config.send_size = MBED_CONF_SIMCOM_SIM800_TRANSPARENT_SEND_SIZE;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+SIMCOM_SIM800_TransparentSocket::~SIMCOM_SIM800_TransparentSocket()
+{
+    if (_connected) {
+        close();
+    }
+}
+
+void SIMCOM_SIM800_TransparentSocket::set_credentials(const char *apn, const char *uname, const char *pwd)
+{
+    _apn = apn;
+    _uname = uname;
+    _pwd = pwd;
+}
+
+void SIMCOM_SIM800_TransparentSocket::set_config(const transparent_config_t &config)
+{
+    _config = config;
+}
+
+bool SIMCOM_SIM800_TransparentSocket::is_data_mode() const
+{
+    return _data_mode;
+}
+
+bool SIMCOM_SIM800_TransparentSocket::is_in_use()
+{
+    return _in_use;
+}
+
+void SIMCOM_SIM800_TransparentSocket::sigio(Callback<void()> func)
+{
+    _sigio_cb = func;
+    if (_data_mode) {
+        _fh->sigio(_sigio_cb);
+    }
+}
+
+nsapi_error_t SIMCOM_SIM800_TransparentSocket::connect(const char *host, uint16_t port)
+{
+    char ip[NSAPI_IPv4_SIZE];
+    char result[20] = {0};
+    SIMCOM_SIM800_ATBatch batch(_at);
+
+    if (_connected) {
+        return NSAPI_ERROR_IS_CONNECTED;
+    }
+
+    _at.lock();
+    // +CIPSHUT and +CIPMUX=0 would tear down the links of the socket stack
+    if (_in_use || SIMCOM_SIM800_CellularContext::is_ip_context_owned()) {
+        _at.unlock();
+        tr_warn("TCP/IP application in use");
+        return NSAPI_ERROR_BUSY;
+    }
+    _in_use = true;
+    // Back to IP INITIAL, CIPMUX and CIPMODE can only be changed there
+    _at.set_at_timeout(SIM800_SHUT_TIMEOUT);
+    _at.cmd_start_stop("+CIPSHUT", "");
+    _at.resp_start("SHUT OK", true);
+    _at.resp_stop();
+    _at.restore_at_timeout();
+
+    batch.add("+CIPMUX", "=", "%d", 0);
+    batch.add("+CIPMODE", "=", "%d", 1);
+    // WaitTm is in 100 ms units, esc 1 enables +++
+    batch.add("+CIPCCFG", "=", "%d%d%d%d", _config.retries, _config.wait_time / 100, _config.send_size, 1);
+    batch.add("+CSTT", "=", "%s%s%s", _apn, _uname, _pwd);
+    nsapi_error_t err = _at.get_last_error();
+    if (err == NSAPI_ERROR_OK) {
+        err = batch.get_last_error();
+    }
+    if (err == NSAPI_ERROR_OK) {
+        err = batch.execute();
+    }
+    if (err == NSAPI_ERROR_OK) {
+        _at.set_at_timeout(SIM800_CIICR_TIMEOUT);
+        err = _at.at_cmd_discard("+CIICR", "");
+        _at.restore_at_timeout();
+    }
+    if (err == NSAPI_ERROR_OK) {
+        err = _at.at_cmd_str("+CIFSREX", "", ip, sizeof(ip));
+    }
+    if (err == NSAPI_ERROR_OK) {
+        _at.at_cmd_discard("+CIPSTART", "=", "%s%s%d", "TCP", host, port);
+        // CONNECT switches to data mode, CONNECT FAIL or CLOSED do not
+        _at.set_at_timeout(TRANSPARENT_CONNECT_TIMEOUT);
+        _at.resp_start("CONNECT", true);
+        _at.read_string(result, sizeof(result));
+        _at.resp_stop();
+        _at.restore_at_timeout();
+        err = _at.get_last_error();
+    }
+    if (err == NSAPI_ERROR_OK && strstr(result, "FAIL")) {
+        err = NSAPI_ERROR_NO_CONNECTION;
+    }
+    if (err == NSAPI_ERROR_OK) {
+        _connected = true;
+        enter_data_mode();
+    } else {
+        _in_use = false;
+    }
+    _at.unlock();
+
+    tr_info("Transparent connect %s:%d - %d", host, port, err);
+    return err;
+}
+
+void SIMCOM_SIM800_TransparentSocket::enter_data_mode()
+{
+    // Same hand-over as PPP: the ATHandler stops reading and writing the FileHandle
+    _fh = _at.get_file_handle();
+    _at.set_is_filehandle_usable(false);
+    _fh->sigio(_sigio_cb);
+    // Raising DTR would drop the modem out of data mode
+    SIMCOM_SIM800_Sleep::hold();
+    _data_mode = true;
+    _data_mode_start = rtos::Kernel::Clock::now();
+}
+
+void SIMCOM_SIM800_TransparentSocket::leave_data_mode()
+{
+    _stats.data_mode_ms += duration_cast<milliseconds>(rtos::Kernel::Clock::now() - _data_mode_start).count();
+    _data_mode = false;
+    SIMCOM_SIM800_Sleep::release();
+    _at.set_is_filehandle_usable(true);
+    _at.set_filehandle_sigio();
+}
+
+nsapi_size_or_error_t SIMCOM_SIM800_TransparentSocket::send(const void *data, nsapi_size_t size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    size_t sent = 0;
+    nsapi_error_t err = NSAPI_ERROR_DEVICE_ERROR;
+
+    if (!_data_mode) {
+        return NSAPI_ERROR_NO_CONNECTION;
+    }
+    auto deadline = rtos::Kernel::Clock::now() + TRANSPARENT_SEND_TIMEOUT;
+    while (sent < size) {
+        ssize_t n = _fh->write(p + sent, size - sent);
+        if (n == -EAGAIN) {
+            // UART transmit buffer full, the link drains it at line rate
+            if (rtos::Kernel::Clock::now() >= deadline) {
+                err = NSAPI_ERROR_TIMEOUT;
+                break;
+            }
+            rtos::ThisThread::sleep_for(1ms);
+            continue;
+        }
+        if (n < 0) {
+            break;
+        }
+        sent += n;
+        deadline = rtos::Kernel::Clock::now() + TRANSPARENT_SEND_TIMEOUT;
+    }
+    _stats.bytes_tx += sent;
+    return sent ? (nsapi_size_or_error_t)sent : err;
+}
+
+nsapi_size_or_error_t SIMCOM_SIM800_TransparentSocket::recv(void *data, nsapi_size_t size)
+{
+    if (!_data_mode) {
+        return NSAPI_ERROR_NO_CONNECTION;
+    }
+    ssize_t n = _fh->read(data, size);
+    if (n == -EAGAIN) {
+        return NSAPI_ERROR_WOULD_BLOCK;
+    }
+    if (n < 0) {
+        return NSAPI_ERROR_DEVICE_ERROR;
+    }
+    _stats.bytes_rx += n;
+    return n;
+}
+
+nsapi_error_t SIMCOM_SIM800_TransparentSocket::escape()
+{
+    if (!_data_mode) {
+        return NSAPI_ERROR_OK;
+    }
+
+    // +++ is only recognised with no data for the guard time before and after
+    rtos::ThisThread::sleep_for(TRANSPARENT_ESCAPE_GUARD);
+    _fh->write("+++", 3);
+    rtos::ThisThread::sleep_for(TRANSPARENT_ESCAPE_GUARD);
+
+    _at.lock();
+    leave_data_mode();
+    _at.clear_error();
+    _at.resp_start();
+    _at.resp_stop();
+    return _at.unlock_return_error();
+}
+
+nsapi_error_t SIMCOM_SIM800_TransparentSocket::resume()
+{
+    if (_data_mode) {
+        return NSAPI_ERROR_OK;
+    }
+    if (!_connected) {
+        return NSAPI_ERROR_NO_CONNECTION;
+    }
+
+    _at.lock();
+    _at.cmd_start_stop("O", "");
+    _at.resp_start("CONNECT", true);
+    _at.resp_stop();
+    nsapi_error_t err = _at.get_last_error();
+    if (err == NSAPI_ERROR_OK) {
+        enter_data_mode();
+    }
+    _at.unlock();
+    return err;
+}
+
+nsapi_error_t SIMCOM_SIM800_TransparentSocket::close()
+{
+    if (!_connected) {
+        // The TCP/IP application may belong to another user
+        return NSAPI_ERROR_NO_CONNECTION;
+    }
+    nsapi_error_t err = escape();
+
+    _at.lock();
+    _at.at_cmd_discard("+CIPCLOSE", "");
+    _at.set_at_timeout(SIM800_SHUT_TIMEOUT);
+    _at.cmd_start_stop("+CIPSHUT", "");
+    _at.resp_start("SHUT OK", true);
+    _at.resp_stop();
+    _at.restore_at_timeout();
+    _at.at_cmd_discard("+CIPMODE", "=", "%d", 0);
+    nsapi_error_t close_err = _at.unlock_return_error();
+    _connected = false;
+    _in_use = false;
+    return err != NSAPI_ERROR_OK ? err : close_err;
+}
+
+void SIMCOM_SIM800_TransparentSocket::get_stats(transparent_stats_t *stats) const
+{
+    *stats = _stats;
+    if (_data_mode) {
+        stats->data_mode_ms += duration_cast<milliseconds>(rtos::Kernel::Clock::now() - _data_mode_start).count();
+    }
+    if (stats->data_mode_ms) {
+        stats->tx_bytes_per_sec = (uint64_t)stats->bytes_tx * 1000 / stats->data_mode_ms;
+        stats->rx_bytes_per_sec = (uint64_t)stats->bytes_rx * 1000 / stats->data_mode_ms;
+    }
+}
+
+void SIMCOM_SIM800_TransparentSocket::reset_stats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+    _data_mode_start = rtos::Kernel::Clock::now();
+}
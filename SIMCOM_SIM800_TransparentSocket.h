@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_TRANSPARENTSOCKET_H_
+#define SIMCOM_SIM800_TRANSPARENTSOCKET_H_
+
+#include "AT_CellularDevice.h"
+#include "ATHandler.h"
+#include "rtos/Kernel.h"
+#include <chrono>
+
+#define TRANSPARENT_ESCAPE_GUARD   1000ms  // Idle time around +++
+#define TRANSPARENT_CONNECT_TIMEOUT 75000ms
+#define TRANSPARENT_SEND_TIMEOUT   10000ms // send() gives up when the UART accepts nothing for this long
+
+#ifndef MBED_CONF_SIMCOM_SIM800_TRANSPARENT_SEND_SIZE
+#define MBED_CONF_SIMCOM_SIM800_TRANSPARENT_SEND_SIZE 1024
+#endif
+#ifndef MBED_CONF_SIMCOM_SIM800_TRANSPARENT_WAIT_TIME
+#define MBED_CONF_SIMCOM_SIM800_TRANSPARENT_WAIT_TIME 200
+#endif
+#ifndef MBED_CONF_SIMCOM_SIM800_TRANSPARENT_RETRIES
+#define MBED_CONF_SIMCOM_SIM800_TRANSPARENT_RETRIES 5
+#endif
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_TransparentSocket
+ *
+ * Single TCP connection in transparent mode (AT+CIPMODE=1). After CONNECT the
+ * UART carries the TCP stream, so send() and recv() go straight to the
+ * FileHandle with no AT framing. The ATHandler stops using the FileHandle
+ * while in data mode, so other AT users fail until escape() or close().
+ *
+ * Transparent mode needs single-link mode, so connect() fails with
+ * NSAPI_ERROR_BUSY while the SIMCOM_SIM800_CellularStack context is up, and
+ * that context refuses to come up while a transparent connection is open.
+ */
+class SIMCOM_SIM800_TransparentSocket {
+public:
+    typedef struct transparent_config
+    {
+    int           retries;     // AT+CIPCCFG NmRetry, 3..8
+    int           wait_time;   // ms the modem waits to fill a packet, 100..1000 in 100 ms steps
+    int           send_size;   // Bytes that trigger a packet before wait_time, 1..1460
+    }transparent_config_t;
+
+    typedef struct transparent_stats
+    {
+    size_t        bytes_tx;        // Payload written in data mode
+    size_t        bytes_rx;        // Payload read in data mode
+    uint32_t      data_mode_ms;    // Time spent in data mode
+    uint32_t      tx_bytes_per_sec;// bytes_tx over data_mode_ms
+    uint32_t      rx_bytes_per_sec;//
+    }transparent_stats_t;
+
+    SIMCOM_SIM800_TransparentSocket(AT_CellularDevice &device);
+    virtual ~SIMCOM_SIM800_TransparentSocket();
+
+    void set_credentials(const char *apn, const char *uname = nullptr, const char *pwd = nullptr);
+
+    /** Packet tuning applied by the next connect(). */
+    void set_config(const transparent_config_t &config);
+
+    /** Bring up the IP context in transparent mode and open the TCP connection.
+     *  host may be a name or an address. Returns in data mode.
+     *
+     *  @return NSAPI_ERROR_BUSY while the multi-link IP context is up
+     */
+    nsapi_error_t connect(const char *host, uint16_t port);
+
+    /** @return bytes written, NSAPI_ERROR_NO_CONNECTION outside data mode,
+     *          NSAPI_ERROR_TIMEOUT if nothing could be written for TRANSPARENT_SEND_TIMEOUT
+     */
+    nsapi_size_or_error_t send(const void *data, nsapi_size_t size);
+
+    /** @return bytes read, NSAPI_ERROR_WOULD_BLOCK if nothing is buffered */
+    nsapi_size_or_error_t recv(void *data, nsapi_size_t size);
+
+    /** Called when the FileHandle becomes readable in data mode. */
+    void sigio(Callback<void()> func);
+
+    /** Leave data mode with +++ and guard times, the connection stays open. */
+    nsapi_error_t escape();
+
+    /** Return to data mode with ATO after escape(). */
+    nsapi_error_t resume();
+
+    /** Close the connection and the IP context. */
+    nsapi_error_t close();
+
+    bool is_data_mode() const;
+
+    /** True from connect() until close() of any transparent socket. */
+    static bool is_in_use();
+    void get_stats(transparent_stats_t *stats) const;
+    void reset_stats();
+
+private:
+    void enter_data_mode();
+    void leave_data_mode();
+
+    ATHandler            &_at;
+    FileHandle           *_fh;
+    const char           *_apn;
+    const char           *_uname;
+    const char           *_pwd;
+    transparent_config_t  _config;
+    Callback<void()>      _sigio_cb;
+
+    bool                  _connected;
+    bool                  _data_mode;
+    rtos::Kernel::Clock::time_point _data_mode_start;
+    transparent_stats_t   _stats;
+
+    // One TCP/IP application in the modem, claimed under the AT lock
+    static volatile bool  _in_use;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_TRANSPARENTSOCKET_H_
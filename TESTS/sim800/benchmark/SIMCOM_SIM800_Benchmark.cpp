@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_Benchmark.h"
+#include "SIMCOM_SIM800_Parser.h"
+#include "drivers/Timer.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+using namespace mbed;
+using namespace std::chrono;
+
+// Lines as the driver sees them after the response prefix
+static const char *const parser_lines[] = {
+    "\"24/03/05,13:45:07-20\"",     // +CCLK
+    " 1,200,1432",                  // +HTTPACTION
+    " POST,2,512,1024",             // +HTTPSTATUS
+};
+
+SIMCOM_SIM800_Benchmark::SIMCOM_SIM800_Benchmark(SIMCOM_SIM800_Simulator &sim): _sim(sim)
+{
+
+}
+
+SIMCOM_SIM800_Benchmark::benchmark_result_t SIMCOM_SIM800_Benchmark::run(const char *name, unsigned int iterations, Callback<bool()> op)
+{
+    benchmark_result_t result = {};
+    SIMCOM_SIM800_Simulator::simulator_counters_t counters;
+    Timer total;
+    Timer lap;
+    unsigned int samples = 0;
+
+    result.name = name;
+    _sim.reset_counters();
+    total.start();
+    for (unsigned int i = 0; i < iterations; i++) {
+        lap.reset();
+        lap.start();
+        if (!op()) {
+            result.failures++;
+        }
+        lap.stop();
+        if (samples < SIM800_BENCH_MAX_SAMPLES) {
+            _samples[samples++] = duration_cast<microseconds>(lap.elapsed_time()).count();
+        }
+    }
+    total.stop();
+    _sim.get_counters(&counters);
+
+    result.iterations = iterations;
+    result.bytes_tx = counters.bytes_rx;
+    result.bytes_rx = counters.bytes_tx;
+    if (total.elapsed_time().count() > 0) {
+        result.ops_per_sec = iterations * 1000000.0f / total.elapsed_time().count();
+    }
+    if (samples) {
+        std::sort(_samples, _samples + samples);
+        result.p50_us = _samples[(samples - 1) / 2];
+        result.p99_us = _samples[((samples - 1) * 99) / 100];
+    }
+    return result;
+}
+
+SIMCOM_SIM800_Benchmark::benchmark_result_t SIMCOM_SIM800_Benchmark::run_init(CellularDevice &device, unsigned int iterations)
+{
+    return run("init", iterations, [&device]() {
+        return device.init() == NSAPI_ERROR_OK;
+    });
+}
+
+SIMCOM_SIM800_Benchmark::benchmark_result_t SIMCOM_SIM800_Benchmark::run_enable_bearer(SIMCOM_SIM800_Bearer &bearer, unsigned int iterations)
+{
+    benchmark_result_t result = {};
+    benchmark_result_t lap;
+
+    // Closing is not part of the measured operation, run one iteration at a time
+    for (unsigned int i = 0; i < iterations; i++) {
+        lap = run("enable_bearer", 1, [&bearer]() {
+            return bearer.enable_bearer(true) == NSAPI_ERROR_OK;
+        });
+        bearer.enable_bearer(false);
+        if (i < SIM800_BENCH_MAX_SAMPLES) {
+            _samples[i] = lap.p50_us;
+        }
+        result.failures += lap.failures;
+        result.bytes_tx += lap.bytes_tx;
+        result.bytes_rx += lap.bytes_rx;
+    }
+
+    uint64_t sum_us = 0;
+    unsigned int samples = std::min(iterations, (unsigned int)SIM800_BENCH_MAX_SAMPLES);
+    for (unsigned int i = 0; i < samples; i++) {
+        sum_us += _samples[i];
+    }
+    result.name = "enable_bearer";
+    result.iterations = iterations;
+    if (sum_us) {
+        result.ops_per_sec = samples * 1000000.0f / sum_us;
+    }
+    if (samples) {
+        std::sort(_samples, _samples + samples);
+        result.p50_us = _samples[(samples - 1) / 2];
+        result.p99_us = _samples[((samples - 1) * 99) / 100];
+    }
+    return result;
+}
+
+SIMCOM_SIM800_Benchmark::benchmark_result_t SIMCOM_SIM800_Benchmark::run_request(SIMCOM_SIM800_HTTP &http, const char *url,
+                                                                                  const char *data_out, int len_out, unsigned int iterations)
+{
+    // Callback storage only fits a single pointer worth of captures
+    struct {
+        SIMCOM_SIM800_HTTP *http;
+        const char *url;
+        const char *data_out;
+        int len_out;
+    } args = {&http, url, data_out, len_out};
+    auto *a = &args;
+
+    return run("http_request", iterations, [a]() {
+        return a->http->request(SIMCOM_SIM800_HTTP::POST, a->url, a->data_out, a->len_out, 0);
+    });
+}
+
+SIMCOM_SIM800_Benchmark::benchmark_result_t SIMCOM_SIM800_Benchmark::run_parser(unsigned int iterations)
+{
+    return run("parser", iterations, []() {
+        struct tm t;
+        int tz, a, b, c, d;
+        return SIMCOM_SIM800_Parser::parse_clock(parser_lines[0], strlen(parser_lines[0]), &t, &tz) &&
+               SIMCOM_SIM800_Parser::parse_http_action(parser_lines[1], strlen(parser_lines[1]), &a, &b, &c) &&
+               SIMCOM_SIM800_Parser::parse_http_status(parser_lines[2], strlen(parser_lines[2]), &a, &b, &c, &d);
+    });
+}
+
+SIMCOM_SIM800_Benchmark::benchmark_result_t SIMCOM_SIM800_Benchmark::run_parser_sscanf(unsigned int iterations)
+{
+    return run("parser_sscanf", iterations, []() {
+        struct tm t;
+        int tz, a, b, c, d;
+        char mode[8];
+        return sscanf(parser_lines[0], "\"%d/%d/%d,%d:%d:%d%d", &t.tm_year, &t.tm_mon, &t.tm_mday,
+                      &t.tm_hour, &t.tm_min, &t.tm_sec, &tz) == 7 &&
+               sscanf(parser_lines[1], "%d,%d,%d", &a, &b, &c) == 3 &&
+               sscanf(parser_lines[2], " %7[^,],%d,%d,%d", mode, &b, &c, &d) == 4;
+    });
+}
+
+void SIMCOM_SIM800_Benchmark::print(const benchmark_result_t &result)
+{
+    printf("%-16s n=%-5u fail=%-3u %8.2f op/s  p50 %8lu us  p99 %8lu us  tx %6lu B  rx %6lu B\r\n",
+           result.name, result.iterations, result.failures, result.ops_per_sec,
+           (unsigned long)result.p50_us, (unsigned long)result.p99_us,
+           (unsigned long)result.bytes_tx, (unsigned long)result.bytes_rx);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_BENCHMARK_H_
+#define SIMCOM_SIM800_BENCHMARK_H_
+
+#include "CellularDevice.h"
+#include "SIMCOM_SIM800_Simulator.h"
+#include "SIMCOM_SIM800_Bearer.h"
+#include "SIMCOM_SIM800_HTTP.h"
+
+#define SIM800_BENCH_MAX_SAMPLES 128
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_Benchmark
+ *
+ * Measures the driver against SIMCOM_SIM800_Simulator. Each run reports
+ * operations per second, p50/p99 end-to-end latency and AT bytes on the wire.
+ * Only the first SIM800_BENCH_MAX_SAMPLES iterations are used for percentiles.
+ */
+class SIMCOM_SIM800_Benchmark {
+public:
+    typedef struct benchmark_result
+    {
+    const char   *name;             //
+    unsigned int  iterations;       //
+    unsigned int  failures;         // Operations that returned an error
+    float         ops_per_sec;      //
+    uint32_t      p50_us;           // Median end-to-end latency
+    uint32_t      p99_us;           //
+    size_t        bytes_tx;         // AT bytes written by the driver
+    size_t        bytes_rx;         // AT bytes read by the driver
+    }benchmark_result_t;
+
+    SIMCOM_SIM800_Benchmark(SIMCOM_SIM800_Simulator &sim);
+
+    /** Run an arbitrary operation. The operation returns true on success.
+     */
+    benchmark_result_t run(const char *name, unsigned int iterations, Callback<bool()> op);
+
+    /** SIMCOM_SIM800::init() */
+    benchmark_result_t run_init(CellularDevice &device, unsigned int iterations);
+    /** SIMCOM_SIM800_Bearer::enable_bearer(true), followed by an untimed enable_bearer(false) */
+    benchmark_result_t run_enable_bearer(SIMCOM_SIM800_Bearer &bearer, unsigned int iterations);
+    /** SIMCOM_SIM800_HTTP::request(POST, ...) */
+    benchmark_result_t run_request(SIMCOM_SIM800_HTTP &http, const char *url, const char *data_out,
+                                   int len_out, unsigned int iterations);
+
+    /** Parse +CCLK, +HTTPACTION and +HTTPSTATUS lines with SIMCOM_SIM800_Parser, no modem traffic */
+    benchmark_result_t run_parser(unsigned int iterations);
+    /** The same lines with the sscanf() patterns the parser replaced, for comparison */
+    benchmark_result_t run_parser_sscanf(unsigned int iterations);
+
+    static void print(const benchmark_result_t &result);
+
+private:
+    SIMCOM_SIM800_Simulator &_sim;
+    uint32_t _samples[SIM800_BENCH_MAX_SAMPLES];
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_BENCHMARK_H_
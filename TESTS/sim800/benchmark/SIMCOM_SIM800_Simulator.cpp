@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SIMCOM_SIM800_Simulator.h"
+#include "rtos/ThisThread.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+using namespace mbed;
+using namespace std::chrono;
+
+#define SIM_OK "\r\nOK\r\n"
+
+static const milliseconds no_delay(0);
+
+SIMCOM_SIM800_Simulator::SIMCOM_SIM800_Simulator(size_t buffer_size):
+    _blocking(true),
+    _echo(true),
+    _http_init(false),
+    _last_method(0),
+    _download_remaining(0),
+    _line_len(0),
+    _seq(0),
+    _out_size(buffer_size),
+    _out_head(0),
+    _out_count(0),
+    _next_byte_at(0)
+{
+    _config.baudrate          = 9600;
+    _config.command_delay     = 5ms;
+    _config.bearer_open_delay = 1500ms;
+    _config.action_delay      = 800ms;
+    _config.status_code       = 200;
+    _config.response_length   = 64;
+    _config.rssi              = 20;
+
+    memset(_bearer_open, 0, sizeof(_bearer_open));
+    memset(_pending, 0, sizeof(_pending));
+    memset(&_counters, 0, sizeof(_counters));
+    _out = new char[_out_size];
+    _clock.start();
+}
+
+SIMCOM_SIM800_Simulator::~SIMCOM_SIM800_Simulator()
+{
+    _wakeup.detach();
+    delete[] _out;
+}
+
+void SIMCOM_SIM800_Simulator::set_config(const simulator_config_t &config)
+{
+    _mutex.lock();
+    _config = config;
+    _mutex.unlock();
+}
+
+const SIMCOM_SIM800_Simulator::simulator_config_t &SIMCOM_SIM800_Simulator::get_config() const
+{
+    return _config;
+}
+
+void SIMCOM_SIM800_Simulator::get_counters(simulator_counters_t *counters) const
+{
+    _mutex.lock();
+    *counters = _counters;
+    _mutex.unlock();
+}
+
+void SIMCOM_SIM800_Simulator::reset_counters()
+{
+    _mutex.lock();
+    memset(&_counters, 0, sizeof(_counters));
+    _mutex.unlock();
+}
+
+void SIMCOM_SIM800_Simulator::set_command_handler(command_handler_t handler)
+{
+    _mutex.lock();
+    _handler = handler;
+    _mutex.unlock();
+}
+
+bool SIMCOM_SIM800_Simulator::respond(const char *text, milliseconds delay)
+{
+    return queue(delay, "%s", text);
+}
+
+ssize_t SIMCOM_SIM800_Simulator::read(void *buffer, size_t size)
+{
+    char *dst = (char *)buffer;
+    size_t count;
+
+    _mutex.lock();
+    while (true) {
+        release_due();
+        count = out_readable();
+        if (count || !_blocking) {
+            break;
+        }
+        _mutex.unlock();
+        rtos::ThisThread::sleep_for(1ms);
+        _mutex.lock();
+    }
+
+    if (count == 0) {
+        arm_wakeup();
+        _mutex.unlock();
+        return -EAGAIN;
+    }
+    if (count > size) {
+        count = size;
+    }
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = _out[_out_head];
+        _out_head = (_out_head + 1) % _out_size;
+    }
+    _out_count -= count;
+    if (_config.baudrate > 0) {
+        _next_byte_at += microseconds(10000000 / _config.baudrate) * count;
+    }
+    _counters.bytes_tx += count;
+
+    // Space was freed, a partially queued +HTTPREAD body may continue
+    release_due();
+    arm_wakeup();
+    _mutex.unlock();
+    return count;
+}
+
+ssize_t SIMCOM_SIM800_Simulator::write(const void *buffer, size_t size)
+{
+    const char *src = (const char *)buffer;
+
+    _mutex.lock();
+    for (size_t i = 0; i < size; i++) {
+        char c = src[i];
+        _counters.bytes_rx++;
+
+        if (_download_remaining) {
+            if (--_download_remaining == 0) {
+                queue(_config.command_delay, SIM_OK);
+            }
+            continue;
+        }
+
+        if (c == '\r' || c == '\n') {
+            if (_line_len) {
+                _line[_line_len] = '\0';
+                if (_echo) {
+                    queue(no_delay, "%s\r", _line);
+                }
+                handle_line(_line);
+                _line_len = 0;
+            }
+        } else if (_line_len < SIM800_SIM_LINE_LENGTH) {
+            _line[_line_len++] = c;
+        }
+    }
+    arm_wakeup();
+    _mutex.unlock();
+    return size;
+}
+
+off_t SIMCOM_SIM800_Simulator::seek(off_t offset, int whence)
+{
+    return -ESPIPE;
+}
+
+int SIMCOM_SIM800_Simulator::close()
+{
+    return 0;
+}
+
+int SIMCOM_SIM800_Simulator::set_blocking(bool blocking)
+{
+    _blocking = blocking;
+    return 0;
+}
+
+bool SIMCOM_SIM800_Simulator::is_blocking() const
+{
+    return _blocking;
+}
+
+short SIMCOM_SIM800_Simulator::poll(short events) const
+{
+    short revents = POLLOUT;
+
+    _mutex.lock();
+    release_due();
+    if (out_readable()) {
+        revents |= POLLIN;
+    }
+    _mutex.unlock();
+    return revents & events;
+}
+
+void SIMCOM_SIM800_Simulator::sigio(Callback<void()> func)
+{
+    _mutex.lock();
+    _sigio_cb = func;
+    arm_wakeup();
+    _mutex.unlock();
+}
+
+void SIMCOM_SIM800_Simulator::handle_line(char *line)
+{
+    if (strncasecmp(line, "AT", 2) != 0) {
+        // Real modem silently drops garbage between commands
+        return;
+    }
+    _counters.commands++;
+
+    // Concatenated line: basic commands run together ("E0+CMEE=1"),
+    // extended commands are separated by ';' outside of quotes.
+    char *cmd = line + 2;
+    command_result result = RESULT_OK;
+    do {
+        char *end = cmd;
+        bool quoted = false;
+        if (*cmd != '+') {
+            while (*end && *end != '+' && *end != ';') {
+                end++;
+            }
+        } else {
+            while (*end && (quoted || *end != ';')) {
+                quoted ^= (*end == '"');
+                end++;
+            }
+        }
+        char next = *end;
+        *end = '\0';
+        result = handle_command(cmd);
+        if (next == ';') {
+            end++;
+        } else {
+            *end = next;
+        }
+        cmd = end;
+    } while (*cmd && result == RESULT_OK);
+
+    if (result == RESULT_ERROR) {
+        _counters.errors++;
+        queue(_config.command_delay, "\r\nERROR\r\n");
+    } else if (result == RESULT_OK) {
+        queue(_config.command_delay, SIM_OK);
+    }
+}
+
+SIMCOM_SIM800_Simulator::command_result SIMCOM_SIM800_Simulator::handle_command(const char *cmd)
+{
+    const milliseconds delay = _config.command_delay;
+    int a = 0, b = 0;
+    unsigned int start = 0, size = 0;
+
+    if (*cmd == '\0') {
+        return RESULT_OK;
+    }
+    if (strcasecmp(cmd, "E0") == 0 || strcasecmp(cmd, "E1") == 0) {
+        _echo = (cmd[1] == '1');
+        return RESULT_OK;
+    }
+    if (strncasecmp(cmd, "+CMEE=", 6) == 0 || strncasecmp(cmd, "+CFUN=", 6) == 0 ||
+            strncasecmp(cmd, "+IFC=", 5) == 0 || strncasecmp(cmd, "+IPR=", 5) == 0 ||
+            strncasecmp(cmd, "+HTTPSSL=", 9) == 0) {
+        return RESULT_OK;
+    }
+    if (strcasecmp(cmd, "+CSQ") == 0) {
+        return queue(delay, "\r\n+CSQ: %d,0\r\n", _config.rssi) ? RESULT_OK : RESULT_ERROR;
+    }
+    if (strcasecmp(cmd, "+CPIN?") == 0) {
+        return queue(delay, "\r\n+CPIN: READY\r\n") ? RESULT_OK : RESULT_ERROR;
+    }
+    if (strcasecmp(cmd, "+CCLK?") == 0) {
+        return queue(delay, "\r\n+CCLK: \"18/06/01,12:00:00+08\"\r\n") ? RESULT_OK : RESULT_ERROR;
+    }
+
+    if (strncasecmp(cmd, "+SAPBR=", 7) == 0) {
+        if (sscanf(cmd + 7, "%d,%d", &a, &b) != 2 || b < 1 || b > SIM800_SIM_BEARER_COUNT) {
+            return RESULT_ERROR;
+        }
+        bool &open = _bearer_open[b - 1];
+        switch (a) {
+            case 0:
+                if (!open) {
+                    return RESULT_ERROR;
+                }
+                open = false;
+                return RESULT_OK;
+            case 1:
+                if (open) {
+                    return RESULT_ERROR;
+                }
+                open = true;
+                return queue(_config.bearer_open_delay, SIM_OK) ? RESULT_QUEUED : RESULT_ERROR;
+            case 2:
+                return queue(delay, "\r\n+SAPBR: %d,%d,\"%s%d\"\r\n", b, open ? 1 : 3,
+                             open ? "10.0.0." : "0.0.0.", open ? b + 1 : 0) ? RESULT_OK : RESULT_ERROR;
+            case 3:
+                return RESULT_OK;
+            default:
+                return RESULT_ERROR;
+        }
+    }
+
+    if (strcasecmp(cmd, "+HTTPINIT") == 0) {
+        if (_http_init) {
+            return RESULT_ERROR;
+        }
+        _http_init = true;
+        return RESULT_OK;
+    }
+    if (strcasecmp(cmd, "+HTTPTERM") == 0) {
+        if (!_http_init) {
+            return RESULT_ERROR;
+        }
+        _http_init = false;
+        return RESULT_OK;
+    }
+    if (strncasecmp(cmd, "+HTTPPARA=", 10) == 0) {
+        return _http_init ? RESULT_OK : RESULT_ERROR;
+    }
+    if (strncasecmp(cmd, "+HTTPDATA=", 10) == 0) {
+        if (!_http_init || sscanf(cmd + 10, "%u,%d", &size, &a) != 2) {
+            return RESULT_ERROR;
+        }
+        if (!queue(delay, "\r\nDOWNLOAD\r\n")) {
+            return RESULT_ERROR;
+        }
+        _download_remaining = size;
+        return size ? RESULT_QUEUED : RESULT_OK;
+    }
+    if (strncasecmp(cmd, "+HTTPACTION=", 12) == 0) {
+        if (!_http_init || sscanf(cmd + 12, "%d", &a) != 1) {
+            return RESULT_ERROR;
+        }
+        _last_method = a;
+        return queue(delay + _config.action_delay, "\r\n+HTTPACTION: %d,%d,%u\r\n",
+                     a, _config.status_code, (unsigned int)_config.response_length) ? RESULT_OK : RESULT_ERROR;
+    }
+    if (strncasecmp(cmd, "+HTTPREAD", 9) == 0) {
+        if (!_http_init) {
+            return RESULT_ERROR;
+        }
+        size = _config.response_length;
+        if (cmd[9] == '=' && sscanf(cmd + 10, "%u,%u", &start, &size) != 2) {
+            return RESULT_ERROR;
+        }
+        if (start >= _config.response_length) {
+            size = 0;
+        } else if (size > _config.response_length - start) {
+            size = _config.response_length - start;
+        }
+        return queue(delay, "\r\n+HTTPREAD: %u\r\n", size) &&
+               queue_body(delay, start, size) ? RESULT_OK : RESULT_ERROR;
+    }
+    if (strcasecmp(cmd, "+HTTPSTATUS?") == 0) {
+        static const char *const methods[] = {"GET", "POST", "HEAD"};
+        return queue(delay, "\r\n+HTTPSTATUS: %s,0,0,0\r\n",
+                     methods[(unsigned int)_last_method < 3 ? _last_method : 0]) ? RESULT_OK : RESULT_ERROR;
+    }
+
+    if (_handler) {
+        return _handler(cmd) ? RESULT_OK : RESULT_ERROR;
+    }
+    return RESULT_ERROR;
+}
+
+SIMCOM_SIM800_Simulator::pending_t *SIMCOM_SIM800_Simulator::alloc_pending(milliseconds delay)
+{
+    for (int i = 0; i < SIM800_SIM_PENDING_COUNT; i++) {
+        if (!_pending[i].used) {
+            _pending[i].used = true;
+            _pending[i].seq = _seq++;
+            _pending[i].due = _clock.elapsed_time() + delay;
+            _pending[i].text[0] = '\0';
+            _pending[i].body_offset = 0;
+            _pending[i].body_len = 0;
+            return &_pending[i];
+        }
+    }
+    return nullptr;
+}
+
+bool SIMCOM_SIM800_Simulator::queue(milliseconds delay, const char *fmt, ...)
+{
+    _mutex.lock();
+    pending_t *p = alloc_pending(delay);
+    if (!p) {
+        _mutex.unlock();
+        return false;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(p->text, sizeof(p->text), fmt, args);
+    va_end(args);
+    if (len < 0 || len >= (int)sizeof(p->text)) {
+        p->used = false;
+        _mutex.unlock();
+        return false;
+    }
+    arm_wakeup();
+    _mutex.unlock();
+    return true;
+}
+
+bool SIMCOM_SIM800_Simulator::queue_body(milliseconds delay, size_t offset, size_t len)
+{
+    if (len == 0) {
+        return true;
+    }
+    pending_t *p = alloc_pending(delay);
+    if (!p) {
+        return false;
+    }
+    p->body_offset = offset;
+    p->body_len = len;
+    return true;
+}
+
+void SIMCOM_SIM800_Simulator::release_due() const
+{
+    const microseconds now = _clock.elapsed_time();
+    const microseconds byte_time(_config.baudrate > 0 ? 10000000 / _config.baudrate : 0);
+
+    while (true) {
+        // Oldest due entry first, ties in queueing order
+        pending_t *next = nullptr;
+        for (int i = 0; i < SIM800_SIM_PENDING_COUNT; i++) {
+            pending_t *p = &_pending[i];
+            if (p->used && p->due <= now &&
+                    (!next || p->due < next->due || (p->due == next->due && p->seq < next->seq))) {
+                next = p;
+            }
+        }
+        if (!next) {
+            return;
+        }
+
+        size_t text_len = strlen(next->text);
+        if (text_len > _out_size - _out_count) {
+            return;
+        }
+        if (_out_count == 0 && _next_byte_at < next->due + byte_time) {
+            _next_byte_at = next->due + byte_time;
+        }
+        for (size_t i = 0; i < text_len; i++) {
+            out_put(next->text[i]);
+        }
+        next->text[0] = '\0';
+
+        while (next->body_len && _out_count < _out_size) {
+            out_put('a' + (next->body_offset % 26));
+            next->body_offset++;
+            next->body_len--;
+        }
+        if (next->body_len) {
+            return;
+        }
+        next->used = false;
+    }
+}
+
+size_t SIMCOM_SIM800_Simulator::out_readable() const
+{
+    if (_out_count == 0 || _config.baudrate <= 0) {
+        return _out_count;
+    }
+    const microseconds now = _clock.elapsed_time();
+    if (now < _next_byte_at) {
+        return 0;
+    }
+    size_t count = 1 + (now - _next_byte_at).count() / (10000000 / _config.baudrate);
+    return count < _out_count ? count : _out_count;
+}
+
+void SIMCOM_SIM800_Simulator::out_put(char c) const
+{
+    _out[(_out_head + _out_count) % _out_size] = c;
+    _out_count++;
+}
+
+void SIMCOM_SIM800_Simulator::arm_wakeup() const
+{
+    if (!_sigio_cb) {
+        return;
+    }
+    const microseconds now = _clock.elapsed_time();
+    microseconds at = microseconds::max();
+
+    if (_out_count) {
+        if (_next_byte_at <= now) {
+            // Reader already has data to consume
+            return;
+        }
+        at = _next_byte_at;
+    } else {
+        for (int i = 0; i < SIM800_SIM_PENDING_COUNT; i++) {
+            if (_pending[i].used && _pending[i].due < at) {
+                at = _pending[i].due;
+            }
+        }
+    }
+    if (at == microseconds::max()) {
+        return;
+    }
+    _wakeup.attach(callback(const_cast<SIMCOM_SIM800_Simulator *>(this), &SIMCOM_SIM800_Simulator::wakeup),
+                   at > now ? at - now : microseconds(0));
+}
+
+void SIMCOM_SIM800_Simulator::wakeup()
+{
+    // Timeout context, the ATHandler sigio handler only defers to its event queue
+    if (_sigio_cb) {
+        _sigio_cb();
+    }
+}
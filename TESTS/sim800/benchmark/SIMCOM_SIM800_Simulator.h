@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMCOM_SIM800_SIMULATOR_H_
+#define SIMCOM_SIM800_SIMULATOR_H_
+
+#include "platform/FileHandle.h"
+#include "platform/Callback.h"
+#include "drivers/Timer.h"
+#include "drivers/Timeout.h"
+#include "rtos/Mutex.h"
+#include <chrono>
+#include <stdint.h>
+
+#define SIM800_SIM_LINE_LENGTH      256
+#define SIM800_SIM_PENDING_COUNT    8
+#define SIM800_SIM_PENDING_LENGTH   64
+#define SIM800_SIM_BEARER_COUNT     3       // SAPBR profiles, CID 1-3
+
+namespace mbed {
+
+/**
+ * Class SIMCOM_SIM800_Simulator
+ *
+ * Scripted SIM800 stand-in implementing FileHandle, so it can be passed to
+ * SIMCOM_SIM800(FileHandle *fh, ...) instead of a BufferedSerial.
+ * It answers the bearer (+SAPBR, each profile separately) and HTTP application (+HTTPINIT, +HTTPPARA,
+ * +HTTPDATA/DOWNLOAD, +HTTPACTION, +HTTPREAD) commands used by this driver.
+ * Responses are paced to the configured baud rate and can be delayed to model
+ * modem processing time and server round-trips.
+ */
+class SIMCOM_SIM800_Simulator : public FileHandle {
+public:
+    typedef struct simulator_config
+    {
+    int                       baudrate;          // UART pacing (8N1), 0 = unpaced
+    std::chrono::milliseconds command_delay;     // Modem processing time before a result code
+    std::chrono::milliseconds bearer_open_delay; // Time taken by +SAPBR=1,1
+    std::chrono::milliseconds action_delay;      // Server round-trip before the +HTTPACTION URC
+    int                       status_code;       // HTTP status code reported in +HTTPACTION
+    size_t                    response_length;   // Body length reported by +HTTPACTION and served by +HTTPREAD
+    int                       rssi;              // Reported by +CSQ
+    }simulator_config_t;
+
+    typedef struct simulator_counters
+    {
+    size_t        bytes_rx;    // AT bytes written by the host
+    size_t        bytes_tx;    // AT bytes read by the host
+    unsigned int  commands;    // Command lines received
+    unsigned int  errors;      // ERROR result codes sent
+    }simulator_counters_t;
+
+    /** Handler for commands the simulator does not know about.
+     *  Receives a single command without the leading "AT" or ';'. Information
+     *  responses are queued with respond(), the simulator then appends OK.
+     *  Returns false to answer ERROR.
+     */
+    typedef Callback<bool(const char *cmd)> command_handler_t;
+
+    SIMCOM_SIM800_Simulator(size_t buffer_size = 1024);
+    virtual ~SIMCOM_SIM800_Simulator();
+
+    void set_config(const simulator_config_t &config);
+    const simulator_config_t &get_config() const;
+    void get_counters(simulator_counters_t *counters) const;
+    void reset_counters();
+    void set_command_handler(command_handler_t handler);
+
+    /** Queue raw modem output, e.g. a URC, after the given delay.
+     *
+     *  @return false if the pending queue is full or the text does not fit
+     */
+    bool respond(const char *text, std::chrono::milliseconds delay = std::chrono::milliseconds(0));
+
+public: // FileHandle
+    virtual ssize_t read(void *buffer, size_t size);
+    virtual ssize_t write(const void *buffer, size_t size);
+    virtual off_t seek(off_t offset, int whence = SEEK_SET);
+    virtual int close();
+    virtual int set_blocking(bool blocking);
+    virtual bool is_blocking() const;
+    virtual short poll(short events) const;
+    virtual void sigio(Callback<void()> func);
+
+private:
+    typedef struct pending
+    {
+    bool                      used;
+    uint32_t                  seq;
+    std::chrono::microseconds due;
+    char                      text[SIM800_SIM_PENDING_LENGTH];
+    size_t                    body_offset; // Generated body bytes emitted after text
+    size_t                    body_len;
+    }pending_t;
+
+    enum command_result
+    {
+        RESULT_OK,      // Append OK once the whole command line is done
+        RESULT_ERROR,   // Abort the command line with ERROR
+        RESULT_QUEUED   // Command queued its own final result or entered data mode
+    };
+
+    void handle_line(char *line);
+    command_result handle_command(const char *cmd);
+    bool queue(std::chrono::milliseconds delay, const char *fmt, ...);
+    bool queue_body(std::chrono::milliseconds delay, size_t offset, size_t len);
+    pending_t *alloc_pending(std::chrono::milliseconds delay);
+    void release_due() const;
+    size_t out_readable() const;
+    void out_put(char c) const;
+    void arm_wakeup() const;
+    void wakeup();
+
+    simulator_config_t   _config;
+    command_handler_t    _handler;
+    Callback<void()>     _sigio_cb;
+    bool                 _blocking;
+    bool                 _echo;
+
+    // Modem state
+    bool                 _bearer_open[SIM800_SIM_BEARER_COUNT];
+    bool                 _http_init;
+    int                  _last_method;
+    size_t               _download_remaining;
+
+    char                 _line[SIM800_SIM_LINE_LENGTH + 1];
+    size_t               _line_len;
+
+    // Modem to host direction. Bytes in _out are on the wire and paced by baud rate.
+    mutable pending_t    _pending[SIM800_SIM_PENDING_COUNT];
+    mutable uint32_t     _seq;
+    mutable char        *_out;
+    size_t               _out_size;
+    mutable size_t       _out_head;
+    mutable size_t       _out_count;
+    mutable std::chrono::microseconds _next_byte_at;
+
+    mutable simulator_counters_t _counters;
+    mutable Timer        _clock;
+    mutable Timeout      _wakeup;
+    mutable rtos::Mutex  _mutex;
+};
+
+} // namespace mbed
+
+#endif // SIMCOM_SIM800_SIMULATOR_H_
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "SIMCOM_SIM800.h"
+#include "SIMCOM_SIM800_Bearer.h"
+#include "SIMCOM_SIM800_Benchmark.h"
+#include "SIMCOM_SIM800_Simulator.h"
+#include "rtos/Thread.h"
+
+#if defined(MBED_CONF_SIMCOM_SIM800_BAUDRATE_TARGET)
+#error [NOT_SUPPORTED] Baud rate negotiation needs a BufferedSerial, set SIMCOM_SIM800.baudrate-target to null
+#endif
+
+using namespace mbed;
+using namespace utest::v1;
+
+#define BENCH_ITERATIONS 10
+
+static SIMCOM_SIM800_Simulator sim;
+static SIMCOM_SIM800 device(&sim);
+static SIMCOM_SIM800_Benchmark bench(sim);
+static SIMCOM_SIM800_Bearer *bearer;
+static rtos::Thread queue_thread;
+
+static void test_init()
+{
+    SIMCOM_SIM800_Benchmark::benchmark_result_t result = bench.run_init(device, BENCH_ITERATIONS);
+    SIMCOM_SIM800_Benchmark::print(result);
+    TEST_ASSERT_EQUAL(0, result.failures);
+}
+
+static void test_enable_bearer()
+{
+    bearer->init_bearer("internet", "", "");
+    SIMCOM_SIM800_Benchmark::benchmark_result_t result = bench.run_enable_bearer(*bearer, BENCH_ITERATIONS);
+    SIMCOM_SIM800_Benchmark::print(result);
+    TEST_ASSERT_EQUAL(0, result.failures);
+}
+
+static void test_request()
+{
+    static const char body[] = "{\"t\":21.5}";
+    TEST_ASSERT_EQUAL(NSAPI_ERROR_OK, bearer->enable_bearer(true));
+    SIMCOM_SIM800_HTTP *http = bearer->open_http();
+    TEST_ASSERT_NOT_NULL(http);
+    TEST_ASSERT_EQUAL(DeviceErrorTypeNoError, http->init(0).errType);
+    SIMCOM_SIM800_Benchmark::benchmark_result_t result = bench.run_request(*http, "http://example.com/",
+                                                                           body, sizeof(body) - 1, BENCH_ITERATIONS);
+    SIMCOM_SIM800_Benchmark::print(result);
+    http->terminate(0);
+    bearer->close_http();
+    bearer->enable_bearer(false);
+    TEST_ASSERT_EQUAL(0, result.failures);
+}
+
+static void test_parser()
+{
+    SIMCOM_SIM800_Benchmark::benchmark_result_t result = bench.run_parser(1000);
+    SIMCOM_SIM800_Benchmark::print(result);
+    TEST_ASSERT_EQUAL(0, result.failures);
+    result = bench.run_parser_sscanf(1000);
+    SIMCOM_SIM800_Benchmark::print(result);
+    TEST_ASSERT_EQUAL(0, result.failures);
+}
+
+static Case cases[] = {
+    Case("init", test_init),
+    Case("enable_bearer", test_enable_bearer),
+    Case("http request", test_request),
+    Case("parser", test_parser),
+};
+
+static utest::v1::status_t greentea_test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(600, "default_auto");
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Specification specification(greentea_test_setup, cases, greentea_test_teardown_handler);
+
+int main()
+{
+    // Bearer and ATHandler events need a dispatched device queue
+    queue_thread.start(mbed::callback(device.get_queue(), &events::EventQueue::dispatch_forever));
+    SIMCOM_SIM800_Bearer b(device);
+    bearer = &b;
+    return !Harness::run(specification);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2018, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * libFuzzer target for SIMCOM_SIM800_Parser, built on the host only:
+ *
+ *   clang++ -g -O1 -fsanitize=fuzzer,address,undefined -I.. \
+ *       ../SIMCOM_SIM800_Parser.cpp SIMCOM_SIM800_Parser_fuzzer.cpp -o parser_fuzzer
+ *   ./parser_fuzzer corpus
+ *
+ * Each input is one modem line. A crash is a sanitizer report, or a line
+ * that parsed into out of range fields.
+ */
+
+#include "SIMCOM_SIM800_Parser.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace mbed;
+
+#define CHECK(cond) do { if (!(cond)) { abort(); } } while (0)
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    const char *line = (const char *)data;
+    struct tm t;
+    int tz, a, b, c, d;
+
+    if (SIMCOM_SIM800_Parser::parse_clock(line, size, &t, &tz)) {
+        CHECK(t.tm_mon >= 0 && t.tm_mon <= 11);
+        CHECK(t.tm_mday >= 1 && t.tm_mday <= 31);
+        CHECK(tz >= -48 && tz <= 56);
+    }
+    if (SIMCOM_SIM800_Parser::parse_http_action(line, size, &a, &b, &c)) {
+        CHECK(a >= 0 && a <= 2 && b >= 0 && c >= 0);
+    }
+    if (SIMCOM_SIM800_Parser::parse_http_status(line, size, &a, &b, &c, &d)) {
+        CHECK(a >= 0 && a <= 2 && b >= 0 && b <= 2 && c >= 0 && d >= 0);
+    }
+
+    // Cursor API on a generic "+PREFIX: <field>,<field>,..." line
+    char buf[SIM800_RESPONSE_LINE_LENGTH];
+    SIMCOM_SIM800_Parser parser(line, size);
+    parser.skip_prefix("+CSQ:");
+    for (int i = 0; i < 8 && parser.ok(); i++) {
+        if ((i & 1) == 0) {
+            if (parser.read_string(buf, sizeof(buf))) {
+                CHECK(strlen(buf) < sizeof(buf));
+            }
+        } else if (parser.read_int(&a)) {
+            parser.optional(',');
+        }
+    }
+    parser.done();
+    return 0;
+}